@@ -59,8 +59,10 @@
 #include "screen.h"
 #include "session.h"
 #include "settings.h"
+#include "spatial.h"
 #include "stacking.h"
 #include "startup_notification.h"
+#include "tabwin.h"
 #include "transients.h"
 #include "workspaces.h"
 #include "xsync.h"
@@ -241,7 +243,8 @@ clientUpdateName (Client *c)
 
     if (refresh)
     {
-        frameQueueDraw (c, TRUE);
+        frameQueueDrawParts (c, FRAME_DIRTY_TITLE);
+        tabwinUpdateClient (c);
     }
 }
 
@@ -370,7 +373,7 @@ urgent_cb (gpointer data)
             if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_SEEN_ACTIVE))
             {
                 FLAG_TOGGLE (c->xfwm_flags, XFWM_FLAG_SEEN_ACTIVE);
-                frameQueueDraw (c, FALSE);
+                frameQueueDrawParts (c, FRAME_DIRTY_STATE);
             }
 
             if (c->blink_iterations)
@@ -387,7 +390,7 @@ urgent_cb (gpointer data)
         {
             c->blink_iterations++;
             FLAG_TOGGLE (c->xfwm_flags, XFWM_FLAG_SEEN_ACTIVE);
-            frameQueueDraw (c, FALSE);
+            frameQueueDrawParts (c, FRAME_DIRTY_STATE);
             return TRUE;
         }
         /*
@@ -398,7 +401,7 @@ urgent_cb (gpointer data)
         if (screen_info->params->repeat_urgent_blink)
         {
             FLAG_TOGGLE (c->xfwm_flags, XFWM_FLAG_SEEN_ACTIVE);
-            frameQueueDraw (c, FALSE);
+            frameQueueDrawParts (c, FRAME_DIRTY_STATE);
             c->blink_iterations = 1;
             return TRUE;
         }
@@ -817,6 +820,7 @@ clientConfigure (Client *c, XWindowChanges * wc, unsigned long mask, unsigned sh
     }
 
     clientConfigureWindows (c, wc, mask, flags);
+    spatialIndexUpdate (c);
     /*
 
       We reparent the client window. According to the ICCCM spec, the
@@ -1304,10 +1308,8 @@ clientFree (Client *c)
     {
         g_source_remove (c->icon_timeout_id);
     }
-    if (c->frame_timeout_id)
-    {
-        g_source_remove (c->frame_timeout_id);
-    }
+    frameClearQueueDraw (c);
+    clientClearNetProps (c);
     if (c->ping_timeout_id)
     {
         clientRemoveNetWMPing (c);
@@ -1480,7 +1482,7 @@ clientUpdateIconPix (Client *c)
 
     if (size > 1)
     {
-        icon = getAppIcon (screen_info, c->window, size, size);
+        icon = getCachedAppIcon (c, size, size);
         if (icon)
         {
             for (i = 0; i < STATE_TOGGLED; i++)
@@ -1716,8 +1718,18 @@ clientFrame (DisplayInfo *display_info, Window w, gboolean recapture)
 
     /* Timout for asynchronous icon update */
     c->icon_timeout_id = 0;
-    /* Timout for asynchronous frame update */
-    c->frame_timeout_id = 0;
+    /* Queued for asynchronous frame update */
+    c->frame_queued = FALSE;
+    /* Decoded application icons, see icons.c */
+    c->app_icons = NULL;
+    /* Not filed in the workspace index until managed */
+    c->workspace_link = NULL;
+    c->strut_indexed = FALSE;
+    /* Nothing written yet, the first update always goes through */
+    c->net_wm_state_size = -1;
+    c->net_wm_actions_size = -1;
+    c->net_props_dirty = 0;
+    c->net_props_queued = FALSE;
     /* Timeout for blinking on urgency */
     c->blink_timeout_id = 0;
     /* Ping timeout  */
@@ -1902,6 +1914,14 @@ clientFrame (DisplayInfo *display_info, Window w, gboolean recapture)
     {
         xfwmPixmapInit (screen_info, &c->appmenu[i]);
     }
+    frameInitTitleCache (c);
+    for (i = 0; i < SIDE_COUNT; i++)
+    {
+        c->side_tiles[i][ACTIVE] = NULL;
+        c->side_tiles[i][INACTIVE] = NULL;
+    }
+    c->shape_nrects = 0;
+    c->shape_generation = 0;
 
     for (i = 0; i < SIDE_COUNT; i++)
     {
@@ -1986,6 +2006,9 @@ clientFrame (DisplayInfo *display_info, Window w, gboolean recapture)
     c->xsync_counter = None;
     c->xsync_alarm = None;
     c->xsync_timeout_id = 0;
+    c->xsync_request_time = 0;
+    c->xsync_srtt = 0;
+    c->xsync_rttvar = 0;
     if (display_info->have_xsync)
     {
         clientGetXSyncCounter (c);
@@ -2025,6 +2048,7 @@ clientUnframe (Client *c, gboolean remap)
     display_info = screen_info->display_info;
 
     clientRemoveFromList (c);
+    tabwinForgetClient (c);
     compositorSetClient (display_info, c->frame, NULL);
 
     myDisplayGrabServer (display_info);
@@ -2053,7 +2077,12 @@ clientUnframe (Client *c, gboolean remap)
         }
     }
 
-    if (!remap)
+    if (remap)
+    {
+        /* Leave the latest state for the next window manager */
+        clientFlushNetProps (c);
+    }
+    else
     {
         XDeleteProperty (display_info->dpy, c->window,
                          display_info->atoms[NET_WM_STATE]);
@@ -2077,6 +2106,9 @@ clientUnframe (Client *c, gboolean remap)
     {
         xfwmPixmapFree (&c->appmenu[i]);
     }
+    frameFreeTitleCache (c);
+    frameReleaseTiles (c);
+    clearAppIconCache (c);
     for (i = 0; i < BUTTON_COUNT; i++)
     {
         xfwmWindowDelete (&c->buttons[i]);
@@ -2249,14 +2281,13 @@ clientSetWorkspaceSingle (Client *c, guint ws)
     {
         TRACE ("setting client \"%s\" (0x%lx) to current_ws %d", c->name, c->window, ws);
         c->win_workspace = ws;
-        if (FLAG_TEST (c->flags, CLIENT_FLAG_STICKY))
-        {
-            setHint (display_info, c->window, NET_WM_DESKTOP, (unsigned long) ALL_WORKSPACES);
-        }
-        else
+        /* Sticky windows keep ALL_WORKSPACES, set by clientStick() */
+        if (!FLAG_TEST (c->flags, CLIENT_FLAG_STICKY))
         {
             setHint (display_info, c->window, NET_WM_DESKTOP, (unsigned long) ws);
         }
+        spatialIndexUpdate (c);
+        workspaceIndexUpdate (c);
     }
     FLAG_SET (c->xfwm_flags, XFWM_FLAG_WORKSPACE_SET);
 }
@@ -2877,6 +2908,7 @@ clientStick (Client *c, gboolean include_transients)
             TRACE ("sticking client \"%s\" (0x%lx)", c2->name, c2->window);
             FLAG_SET (c2->flags, CLIENT_FLAG_STICKY);
             setHint (display_info, c2->window, NET_WM_DESKTOP, (unsigned long) ALL_WORKSPACES);
+            workspaceIndexUpdate (c2);
             frameQueueDraw (c2, FALSE);
         }
         g_list_free (list_of_windows);
@@ -2886,6 +2918,7 @@ clientStick (Client *c, gboolean include_transients)
         TRACE ("sticking client \"%s\" (0x%lx)", c->name, c->window);
         FLAG_SET (c->flags, CLIENT_FLAG_STICKY);
         setHint (display_info, c->window, NET_WM_DESKTOP, (unsigned long) ALL_WORKSPACES);
+        workspaceIndexUpdate (c);
     }
     clientSetWorkspace (c, screen_info->current_ws, TRUE);
     clientSetNetState (c);
@@ -2915,6 +2948,7 @@ clientUnstick (Client *c, gboolean include_transients)
             TRACE ("unsticking client \"%s\" (0x%lx)", c2->name, c2->window);
             FLAG_UNSET (c2->flags, CLIENT_FLAG_STICKY);
             setHint (display_info, c2->window, NET_WM_DESKTOP, (unsigned long) screen_info->current_ws);
+            workspaceIndexUpdate (c2);
             frameQueueDraw (c2, FALSE);
         }
         g_list_free (list_of_windows);
@@ -2924,6 +2958,7 @@ clientUnstick (Client *c, gboolean include_transients)
         TRACE ("unsticking client \"%s\" (0x%lx)", c->name, c->window);
         FLAG_UNSET (c->flags, CLIENT_FLAG_STICKY);
         setHint (display_info, c->window, NET_WM_DESKTOP, (unsigned long) screen_info->current_ws);
+        workspaceIndexUpdate (c);
     }
     clientSetWorkspace (c, screen_info->current_ws, TRUE);
     clientSetNetState (c);
@@ -3631,14 +3666,53 @@ clientIncOpacity (Client *c)
     }
 }
 
+static void
+clientReconstrain (Client *c, gboolean fully_visible)
+{
+    XWindowChanges wc;
+    unsigned short configure_flags;
+
+    if (FLAG_TEST (c->flags, CLIENT_FLAG_FULLSCREEN))
+    {
+        clientUpdateFullscreenSize (c);
+    }
+    else if (FLAG_TEST (c->flags, CLIENT_FLAG_MAXIMIZED))
+    {
+        clientUpdateMaximizeSize (c);
+    }
+    else
+    {
+        configure_flags = CFG_CONSTRAINED | CFG_REQUEST;
+        if (fully_visible)
+        {
+            configure_flags |= CFG_KEEP_VISIBLE;
+        }
+        if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_SAVED_POS))
+        {
+            wc.x = c->saved_x;
+            wc.y = c->saved_y;
+        }
+        else
+        {
+            FLAG_SET (c->xfwm_flags, XFWM_FLAG_SAVED_POS);
+
+            c->saved_x = c->x;
+            c->saved_y = c->y;
+
+            wc.x = c->x;
+            wc.y = c->y;
+        }
+
+        clientConfigure (c, &wc, CWX | CWY, configure_flags);
+    }
+}
+
 /* Xrandr stuff: on screen size change, make sure all clients are still visible */
 void
 clientScreenResize(ScreenInfo *screen_info, gboolean fully_visible)
 {
     Client *c = NULL;
     GList *list, *list_of_windows;
-    XWindowChanges wc;
-    unsigned short configure_flags;
 
     list_of_windows = clientGetStackList (screen_info);
 
@@ -3648,55 +3722,97 @@ clientScreenResize(ScreenInfo *screen_info, gboolean fully_visible)
     }
 
     /* Revalidate client struts */
+    for (list = screen_info->strut_clients; list; list = g_list_next (list))
+    {
+        clientValidateNetStrut ((Client *) list->data);
+    }
+
     for (list = list_of_windows; list; list = g_list_next (list))
     {
         c = (Client *) list->data;
-        if (FLAG_TEST (c->flags, CLIENT_FLAG_HAS_STRUT))
+        if (CONSTRAINED_WINDOW (c))
         {
-            clientValidateNetStrut (c);
+            clientReconstrain (c, fully_visible);
         }
     }
 
-    for (list = list_of_windows; list; list = g_list_next (list))
+    g_list_free (list_of_windows);
+}
+
+static gboolean
+clientFrameIntersects (Client *c, gint x, gint y, GdkRectangle *area)
+{
+    GdkRectangle win;
+
+    win.x = x - frameExtentLeft (c);
+    win.y = y - frameExtentTop (c);
+    win.width = frameExtentWidth (c);
+    win.height = frameExtentHeight (c);
+
+    return gdk_rectangle_intersect (&win, area, NULL);
+}
+
+/*
+ * The work area margins changed from "previous_margins": only the windows
+ * on or next to the edges that moved, or that would go back there, need
+ * to be constrained again.
+ */
+void
+clientWorkareaResize (ScreenInfo *screen_info, int *previous_margins)
+{
+    Client *c = NULL;
+    GList *list, *list_of_windows;
+    GdkRectangle edges[4];
+    guint i, n_edges, j;
+    int size;
+
+    g_return_if_fail (screen_info != NULL);
+    g_return_if_fail (previous_margins != NULL);
+
+    n_edges = 0;
+    for (i = 0; i < 4; i++)
     {
-        c = (Client *) list->data;
-        if (!CONSTRAINED_WINDOW (c))
+        if (previous_margins[i] == screen_info->margins[i])
         {
             continue;
         }
+        /* One more pixel so windows right against the edge are included */
+        size = MAX (previous_margins[i], screen_info->margins[i]) + 1;
+        edges[n_edges].x = (i == STRUTS_RIGHT) ? screen_info->logical_width - size : 0;
+        edges[n_edges].y = (i == STRUTS_BOTTOM) ? screen_info->logical_height - size : 0;
+        edges[n_edges].width = ((i == STRUTS_LEFT) || (i == STRUTS_RIGHT)) ? size : screen_info->logical_width;
+        edges[n_edges].height = ((i == STRUTS_TOP) || (i == STRUTS_BOTTOM)) ? size : screen_info->logical_height;
+        n_edges++;
+    }
 
-        if (FLAG_TEST (c->flags, CLIENT_FLAG_FULLSCREEN))
-        {
-            clientUpdateFullscreenSize (c);
-        }
-        else if (FLAG_TEST (c->flags, CLIENT_FLAG_MAXIMIZED))
+    if (n_edges == 0)
+    {
+        return;
+    }
+
+    for (list = screen_info->strut_clients; list; list = g_list_next (list))
+    {
+        clientValidateNetStrut ((Client *) list->data);
+    }
+
+    list_of_windows = clientGetStackList (screen_info);
+    for (list = list_of_windows; list; list = g_list_next (list))
+    {
+        c = (Client *) list->data;
+        if (!CONSTRAINED_WINDOW (c) || FLAG_TEST (c->flags, CLIENT_FLAG_FULLSCREEN))
         {
-            clientUpdateMaximizeSize (c);
+            continue;
         }
-        else
+
+        for (j = 0; j < n_edges; j++)
         {
-            configure_flags = CFG_CONSTRAINED | CFG_REQUEST;
-            if (fully_visible)
-            {
-                configure_flags |= CFG_KEEP_VISIBLE;
-            }
-            if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_SAVED_POS))
-            {
-                wc.x = c->saved_x;
-                wc.y = c->saved_y;
-            }
-            else
+            if (clientFrameIntersects (c, c->x, c->y, &edges[j]) ||
+                (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_SAVED_POS) &&
+                 clientFrameIntersects (c, c->saved_x, c->saved_y, &edges[j])))
             {
-                FLAG_SET (c->xfwm_flags, XFWM_FLAG_SAVED_POS);
-
-                c->saved_x = c->x;
-                c->saved_y = c->y;
-
-                wc.x = c->x;
-                wc.y = c->y;
+                clientReconstrain (c, FALSE);
+                break;
             }
-
-            clientConfigure (c, &wc, CWX | CWY, configure_flags);
         }
     }
 
@@ -3786,7 +3902,7 @@ clientButtonPressEventFilter (XfwmEvent *event, gpointer data)
                 if ((event->crossing.mode != NotifyGrab) && (event->crossing.mode != NotifyUngrab))
                 {
                     c->button_status[b] = BUTTON_STATE_PRESSED;
-                    frameQueueDraw (c, FALSE);
+                    frameQueueDrawParts (c, FRAME_DIRTY_BUTTON (b));
                 }
             }
             else
@@ -3794,7 +3910,7 @@ clientButtonPressEventFilter (XfwmEvent *event, gpointer data)
                 if ((event->crossing.mode != NotifyGrab) && (event->crossing.mode != NotifyUngrab))
                 {
                     c->button_status[b] = BUTTON_STATE_NORMAL;
-                    frameQueueDraw (c, FALSE);
+                    frameQueueDrawParts (c, FRAME_DIRTY_BUTTON (b));
                 }
             }
             status = EVENT_FILTER_STOP;
@@ -3862,7 +3978,7 @@ clientButtonPress (Client *c, Window w, XfwmEventButton *event)
     passdata.b = b;
 
     c->button_status[b] = BUTTON_STATE_PRESSED;
-    frameQueueDraw (c, FALSE);
+    frameQueueDrawParts (c, FRAME_DIRTY_BUTTON (b));
 
     TRACE ("entering button press loop");
     eventFilterPush (display_info->xfilter, clientButtonPressEventFilter, &passdata);
@@ -95,6 +95,7 @@
 
 
 #define STRUTS_SIZE                     12
+#define NET_ATOMS_SIZE                  16
 
 #ifndef CLIENT_MIN_VISIBLE
 #define CLIENT_MIN_VISIBLE              15
@@ -104,6 +105,14 @@
 #define CLIENT_XSYNC_TIMEOUT            500  /* ms */
 #endif
 
+#ifndef CLIENT_XSYNC_MAX_TIMEOUT
+#define CLIENT_XSYNC_MAX_TIMEOUT        2000 /* ms */
+#endif
+
+#ifndef CLIENT_XSYNC_MIN_INTERVAL
+#define CLIENT_XSYNC_MIN_INTERVAL       8    /* ms */
+#endif
+
 #ifndef CLIENT_BLINK_TIMEOUT
 #define CLIENT_BLINK_TIMEOUT            500  /* ms */
 #endif
@@ -274,6 +283,24 @@ typedef enum
 }
 tilePositionType;
 
+typedef struct _FrameTile FrameTile;
+
+/* Client area plus every decoration window */
+#define CLIENT_SHAPE_RECTS              (1 + 1 + SIDE_COUNT + CORNER_COUNT + BUTTON_COUNT)
+
+typedef struct _TitleCache TitleCache;
+struct _TitleCache
+{
+    /* What the pixmaps were rendered for */
+    guint layout_serial;
+    guint theme_generation;
+    gint width, height;
+    gint left, right;
+
+    xfwmPixmap title;
+    xfwmPixmap top;
+};
+
 struct _Client
 {
     /* Reference to our screen structure */
@@ -291,6 +318,19 @@ struct _Client
     Window client_leader;
     Window group_leader;
     xfwmPixmap appmenu[STATE_TOGGLED];
+    /* Decoded application icon sizes, dropped when the icon changes */
+    GSList *app_icons;
+    /* Title text layout and rendered title for ACTIVE and INACTIVE */
+    PangoLayout *title_layout;
+    guint title_layout_generation;
+    guint title_layout_serial;
+    TitleCache title_cache[2];
+    /* Shared side pixmaps in use for ACTIVE and INACTIVE, see frame.c */
+    FrameTile *side_tiles[SIDE_COUNT][2];
+    /* Frame shape last set from rectangles, valid for shape_generation */
+    XRectangle shape_rects[CLIENT_SHAPE_RECTS];
+    gint shape_nrects;
+    guint shape_generation;
     Colormap cmap;
     unsigned long win_layer;
     unsigned long serial;
@@ -346,8 +386,9 @@ struct _Client
     gint dialog_fd;
     /* Timout for asynchronous icon update */
     guint icon_timeout_id;
-    /* Timout for asynchronous frame update */
-    guint frame_timeout_id;
+    /* Queued for asynchronous frame update */
+    gboolean frame_queued;
+    guint frame_dirty;
     /* Timout to manage blinking decorations for urgent windows */
     guint blink_timeout_id;
     /* Timout for asynchronous icon update */
@@ -356,6 +397,26 @@ struct _Client
     guint32 opacity;
     guint32 opacity_applied;
     guint opacity_flags;
+    /* Cells covered in the spatial index */
+    gboolean spatial_indexed;
+    guint spatial_ws;
+    gint spatial_cells[4];
+    guint spatial_stamp;
+    /* Link in the per-workspace membership index, see workspaces.c */
+    GList *workspace_link;
+    guint workspace_key;
+    /* Orders clients picked from the index, see clientSortStackList() and clientSortRingList() */
+    guint stack_position;
+    gint64 ring_key;
+    /* Listed in screen_info->strut_clients, see placement.c */
+    gboolean strut_indexed;
+    /* Last _NET_WM_STATE and _NET_WM_ALLOWED_ACTIONS written, see netwm.c */
+    Atom net_wm_state[NET_ATOMS_SIZE];
+    gint net_wm_state_size;
+    Atom net_wm_actions[NET_ATOMS_SIZE];
+    gint net_wm_actions_size;
+    guint net_props_dirty;
+    gboolean net_props_queued;
 
 #ifdef HAVE_LIBSTARTUP_NOTIFICATION
     /* Startup notification */
@@ -367,7 +428,13 @@ struct _Client
     XSyncCounter xsync_counter;
     XSyncValue xsync_value;
     XSyncValue next_xsync_value;
+    /* Value of the last sync request sent, acked when the counter reaches it */
+    XSyncValue xsync_sent_value;
     guint xsync_timeout_id;
+    /* Time of the last sync request sent and its round trip, in usec */
+    gint64 xsync_request_time;
+    guint xsync_srtt;
+    guint xsync_rttvar;
 #endif /* HAVE_XSYNC */
 };
 
@@ -492,6 +559,8 @@ void                     clientUpdateCursor                     (Client *);
 void                     clientUpdateAllCursor                  (ScreenInfo *);
 void                     clientScreenResize                     (ScreenInfo *,
                                                                  gboolean);
+void                     clientWorkareaResize                   (ScreenInfo *,
+                                                                 int *);
 void                     clientButtonPress                      (Client *,
                                                                  Window,
                                                                  XfwmEventButton *);
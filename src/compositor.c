@@ -53,7 +53,9 @@
 #include "client.h"
 #include "frame.h"
 #include "hints.h"
+#include "pixel.h"
 #include "compositor.h"
+#include "xsync.h"
 
 #ifdef HAVE_COMPOSITOR
 #include <X11/extensions/Xcomposite.h>
@@ -967,7 +969,6 @@ cursor_to_picture (ScreenInfo *screen_info, XFixesCursorImage *cursor)
     Pixmap             pixmap;
     Picture            picture;
     GC                 gc;
-    gint               i;
 
     g_return_val_if_fail (screen_info != NULL, None);
     TRACE ("entering");
@@ -976,10 +977,7 @@ cursor_to_picture (ScreenInfo *screen_info, XFixesCursorImage *cursor)
 
     /* XFixesGetCursorImage() returns an array of long but actual data is 32bit */
     data = g_malloc (cursor->width * cursor->height * sizeof (guint32));
-    for (i = 0; i < cursor->width * cursor->height; i++)
-    {
-        data[i] = cursor->pixels[i];
-    }
+    pixelArgbToArgb32 (cursor->pixels, data, cursor->width * cursor->height);
 
     ximage = XCreateImage (display_info->dpy,
                            screen_info->visual,
@@ -3292,8 +3290,16 @@ compositorHandleDamage (DisplayInfo *display_info, XDamageNotifyEvent *ev)
     if ((cw) && WIN_IS_REDIRECTED(cw))
     {
         screen_info = cw->screen_info;
-        repair_win (cw, &ev->area);
         screen_info->damages_pending = ev->more;
+#ifdef HAVE_XSYNC
+        if ((cw->c) && clientXSyncFramePending (cw->c))
+        {
+            /* Half drawn client frame, repaired once the client is done */
+            TRACE ("window 0x%lx frame pending, damage deferred", cw->id);
+            return;
+        }
+#endif /* HAVE_XSYNC */
+        repair_win (cw, &ev->area);
     }
 }
 
@@ -3859,6 +3865,28 @@ compositorIsActive (ScreenInfo *screen_info)
     return FALSE;
 }
 
+gboolean
+compositorIsFramePending (ScreenInfo *screen_info)
+{
+#ifdef HAVE_COMPOSITOR
+    g_return_val_if_fail (screen_info != NULL, FALSE);
+
+    if (!screen_info->compositor_active)
+    {
+        return FALSE;
+    }
+#ifdef HAVE_PRESENT_EXTENSION
+    if (screen_info->present_pending)
+    {
+        return TRUE;
+    }
+#endif /* HAVE_PRESENT_EXTENSION */
+    /* Damage not painted yet, the next frame is still to come */
+    return (screen_info->allDamage != None);
+#endif /* HAVE_COMPOSITOR */
+    return FALSE;
+}
+
 void
 compositorAddWindow (DisplayInfo *display_info, Window id, Client *c)
 {
@@ -3949,6 +3977,29 @@ compositorDamageWindow (DisplayInfo *display_info, Window id)
 #endif /* HAVE_COMPOSITOR */
 }
 
+void
+compositorRepairWindow (DisplayInfo *display_info, Window id)
+{
+#ifdef HAVE_COMPOSITOR
+    CWindow *cw;
+
+    g_return_if_fail (display_info != NULL);
+    g_return_if_fail (id != None);
+    TRACE ("window 0x%lx", id);
+
+    if (!compositorIsUsable (display_info))
+    {
+        return;
+    }
+
+    cw = find_cwindow_in_display (display_info, id);
+    if ((cw) && WIN_IS_REDIRECTED(cw))
+    {
+        repair_win (cw, NULL);
+    }
+#endif /* HAVE_COMPOSITOR */
+}
+
 void
 compositorResizeWindow (DisplayInfo *display_info, Window id, int x, int y, int width, int height)
 {
@@ -44,6 +44,7 @@ enum
 
 gboolean                 compositorIsUsable                     (DisplayInfo *);
 gboolean                 compositorIsActive                     (ScreenInfo *);
+gboolean                 compositorIsFramePending               (ScreenInfo *);
 void                     compositorAddWindow                    (DisplayInfo *,
                                                                  Window,
                                                                  Client *);
@@ -54,6 +55,8 @@ void                     compositorRemoveWindow                 (DisplayInfo *,
                                                                  Window);
 void                     compositorDamageWindow                 (DisplayInfo *,
                                                                  Window);
+void                     compositorRepairWindow                 (DisplayInfo *,
+                                                                 Window);
 void                     compositorResizeWindow                 (DisplayInfo *,
                                                                  Window,
                                                                  int,
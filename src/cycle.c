@@ -95,7 +95,8 @@ clientCycleCreateList (Client *c)
     ScreenInfo *screen_info;
     Client *c2;
     guint range, search_range,   i;
-    GList *client_list;
+    GList *client_list, *modals;
+    GList *candidates, *list;
 
     g_return_val_if_fail (c, NULL);
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
@@ -103,9 +104,28 @@ clientCycleCreateList (Client *c)
     screen_info = c->screen_info;
     range = clientGetCycleRange (screen_info);
     client_list = NULL;
+    modals = NULL;
 
-    for (c2 = c, i = 0; c && i < screen_info->client_count; i++, c2 = c2->next)
+    if (range & SEARCH_INCLUDE_ALL_WORKSPACES)
     {
+        candidates = NULL;
+        for (c2 = c, i = 0; i < screen_info->client_count; i++, c2 = c2->next)
+        {
+            candidates = g_list_prepend (candidates, c2);
+        }
+        candidates = g_list_reverse (candidates);
+    }
+    else
+    {
+        /* Sticky windows follow the current workspace */
+        candidates = workspaceGetClients (screen_info, screen_info->current_ws);
+        candidates = g_list_concat (candidates, workspaceGetClients (screen_info, ALL_WORKSPACES));
+        candidates = clientSortRingList (c, candidates);
+    }
+
+    for (list = candidates; list; list = g_list_next (list))
+    {
+        c2 = (Client *) list->data;
         search_range = range;
         /*
          *  We want to include modals even if skip pager/taskbar because
@@ -150,7 +170,7 @@ clientCycleCreateList (Client *c)
             }
             else
             {
-                if (g_list_find_custom (client_list, c2, clientCompareModal))
+                if (g_list_find_custom (modals, c2, clientCompareModal))
                 {
                     TRACE ("%s found as modal list", c2->name);
                     continue;
@@ -159,10 +179,17 @@ clientCycleCreateList (Client *c)
         }
 
         TRACE ("adding %s", c2->name);
-        client_list = g_list_append (client_list, c2);
+        client_list = g_list_prepend (client_list, c2);
+        /* Only modals can be modal for the windows that follow */
+        if (FLAG_TEST (c2->flags, CLIENT_FLAG_STATE_MODAL))
+        {
+            modals = g_list_prepend (modals, c2);
+        }
     }
+    g_list_free (candidates);
+    g_list_free (modals);
 
-    return client_list;
+    return g_list_reverse (client_list);
 }
 
 static void
@@ -537,7 +564,6 @@ clientCycle (Client * c, XfwmEventKey *event)
     }
 
     tabwinDestroy (passdata.tabwin);
-    g_free (passdata.tabwin);
     g_list_free (client_list);
 
     if (passdata.inside)
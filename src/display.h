@@ -281,6 +281,8 @@ typedef struct _xfwmPixmap        xfwmPixmap;
 typedef struct _XfwmParams        XfwmParams;
 typedef struct _ScreenInfo        ScreenInfo;
 typedef struct _Settings          Settings;
+typedef struct _ThemeCache        ThemeCache;
+typedef struct _Tabwin            Tabwin;
 
 struct _DisplayInfo
 {
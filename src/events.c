@@ -60,7 +60,9 @@
 #include "netwm.h"
 #include "menu.h"
 #include "hints.h"
+#include "icons.h"
 #include "startup_notification.h"
+#include "tabwin.h"
 #include "compositor.h"
 #include "events.h"
 #include "event_filter.h"
@@ -1386,7 +1388,7 @@ handleEnterNotify (DisplayInfo *display_info, XfwmEventCrossing *event)
     ScreenInfo *screen_info;
     Client *c;
     int b;
-    gboolean need_redraw;
+    guint redraw_parts;
 
     /* See http://rfc-ref.org/RFC-TEXTS/1013/chapter12.html for details */
 
@@ -1401,7 +1403,7 @@ handleEnterNotify (DisplayInfo *display_info, XfwmEventCrossing *event)
 
     TRACE ("window (0x%lx)", event->meta.window);
 
-    need_redraw = FALSE;
+    redraw_parts = 0;
     c = myDisplayGetClientFromWindow (display_info, event->meta.window,
                                       SEARCH_FRAME | SEARCH_BUTTON);
     if (c)
@@ -1437,13 +1439,13 @@ handleEnterNotify (DisplayInfo *display_info, XfwmEventCrossing *event)
                     if (!xfwmPixmapNone(clientGetButtonPixmap(c, b, PRELIGHT)))
                     {
                         c->button_status[b] = BUTTON_STATE_PRELIGHT;
-                        need_redraw = TRUE;
+                        redraw_parts |= FRAME_DIRTY_BUTTON (b);
                     }
                 }
             }
-            if (need_redraw)
+            if (redraw_parts)
             {
-                frameQueueDraw (c, FALSE);
+                frameQueueDrawParts (c, redraw_parts);
             }
         }
 
@@ -1480,11 +1482,11 @@ handleLeaveNotify (DisplayInfo *display_info, XfwmEventCrossing *event)
 {
     Client *c;
     int b;
-    gboolean need_redraw;
+    guint redraw_parts;
 
     TRACE ("entering");
 
-    need_redraw = FALSE;
+    redraw_parts = 0;
     c = myDisplayGetClientFromWindow (display_info, event->meta.window,
                                       SEARCH_FRAME | SEARCH_BUTTON);
     if (c)
@@ -1496,13 +1498,13 @@ handleLeaveNotify (DisplayInfo *display_info, XfwmEventCrossing *event)
                 if (MYWINDOW_XWINDOW(c->buttons[b]) == event->meta.window)
                 {
                     c->button_status[b] = BUTTON_STATE_NORMAL;
-                    need_redraw = TRUE;
+                    redraw_parts |= FRAME_DIRTY_BUTTON (b);
                 }
             }
         }
-        if (need_redraw)
+        if (redraw_parts)
         {
-            frameQueueDraw (c, FALSE);
+            frameQueueDrawParts (c, redraw_parts);
         }
 
         /* No need to process the event any further */
@@ -1686,6 +1688,7 @@ handlePropertyNotify (DisplayInfo *display_info, XPropertyEvent * ev)
     eventFilterStatus status;
     ScreenInfo *screen_info;
     Client *c;
+    long icon_flags;
 
     TRACE ("entering");
 
@@ -1717,22 +1720,40 @@ handlePropertyNotify (DisplayInfo *display_info, XPropertyEvent * ev)
         {
             TRACE ("client \"%s\" (0x%lx) has received a XA_WM_HINTS notify", c->name, c->window);
 
-            /* Free previous wmhints if any */
+            /* Free previous wmhints if any, remember whether it had an icon */
+            icon_flags = 0;
             if (c->wmhints)
             {
+                icon_flags = c->wmhints->flags & (IconPixmapHint | IconMaskHint);
                 XFree (c->wmhints);
             }
 
             c->wmhints = XGetWMHints (display_info->dpy, c->window);
             if (c->wmhints)
             {
-                if (c->wmhints->flags & WindowGroupHint)
+                icon_flags |= c->wmhints->flags & (IconPixmapHint | IconMaskHint);
+            }
+
+            /*
+             * Clients redraw into the same icon pixmap and set the hints
+             * again to tell, so any hints with an icon, before or now, may
+             * have changed it. Hints without one (urgency, input) do not.
+             */
+            if (icon_flags)
+            {
+                clearAppIconCache (c);
+                tabwinUpdateClient (c);
+                if (screen_info->params->show_app_icon)
                 {
-                    c->group_leader = c->wmhints->window_group;
+                    clientUpdateIcon (c);
                 }
-                if ((c->wmhints->flags & IconPixmapHint) && (screen_info->params->show_app_icon))
+            }
+
+            if (c->wmhints)
+            {
+                if (c->wmhints->flags & WindowGroupHint)
                 {
-                    clientUpdateIcon (c);
+                    c->group_leader = c->wmhints->window_group;
                 }
                 if (HINTS_ACCEPT_INPUT (c->wmhints))
                 {
@@ -1829,11 +1850,16 @@ handlePropertyNotify (DisplayInfo *display_info, XPropertyEvent * ev)
                 FLAG_UNSET (c->xfwm_flags, XFWM_FLAG_OPACITY_LOCKED);
             }
         }
-        else if ((screen_info->params->show_app_icon) &&
-                 ((ev->atom == display_info->atoms[NET_WM_ICON]) ||
-                  (ev->atom == display_info->atoms[KWM_WIN_ICON])))
+        else if ((ev->atom == display_info->atoms[NET_WM_ICON]) ||
+                 (ev->atom == display_info->atoms[KWM_WIN_ICON]))
         {
-            clientUpdateIcon (c);
+            TRACE ("client \"%s\" (0x%lx) has received a NET_WM_ICON notify", c->name, c->window);
+            clearAppIconCache (c);
+            tabwinUpdateClient (c);
+            if (screen_info->params->show_app_icon)
+            {
+                clientUpdateIcon (c);
+            }
         }
         else if (ev->atom == display_info->atoms[GTK_FRAME_EXTENTS])
         {
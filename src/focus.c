@@ -81,12 +81,18 @@ clientGetTopMostFocusable (ScreenInfo *screen_info, guint layer, GList * exclude
 {
     ClientPair top_client;
     Client *c;
+    GList *candidates;
     GList *list;
 
     TRACE ("entering");
 
+    /* Only windows on the current workspace or sticky ones can be visible */
+    candidates = workspaceGetClients (screen_info, screen_info->current_ws);
+    candidates = g_list_concat (candidates, workspaceGetClients (screen_info, ALL_WORKSPACES));
+    candidates = clientSortStackList (screen_info, candidates);
+
     top_client.prefered = top_client.highest = NULL;
-    for (list = screen_info->windows_stack; list; list = g_list_next (list))
+    for (list = candidates; list; list = g_list_next (list))
     {
         c = (Client *) list->data;
         TRACE ("stack window \"%s\" (0x%lx), layer %i", c->name,
@@ -113,6 +119,7 @@ clientGetTopMostFocusable (ScreenInfo *screen_info, guint layer, GList * exclude
             }
         }
     }
+    g_list_free (candidates);
 
     return top_client;
 }
@@ -427,6 +434,36 @@ clientSortRing(Client *c)
         screen_info->clients->prev = c;
     }
     screen_info->clients = c;
+    c->ring_key = --screen_info->ring_first;
+}
+
+static gint
+clientCompareRingKey (gconstpointer a, gconstpointer b, gpointer data)
+{
+    gint64 ka, kb, start;
+
+    start = ((Client *) data)->ring_key;
+    ka = ((Client *) a)->ring_key;
+    kb = ((Client *) b)->ring_key;
+
+    /* The ring wraps around after the last client */
+    if ((ka >= start) != (kb >= start))
+    {
+        return (ka >= start) ? -1 : 1;
+    }
+    return (ka < kb) ? -1 : ((ka > kb) ? 1 : 0);
+}
+
+/*
+ * Sorts the given clients in focus ring order, starting from "c". Each
+ * client keeps a key that only changes when it is moved in the ring.
+ */
+GList *
+clientSortRingList (Client *c, GList *list)
+{
+    g_return_val_if_fail (c != NULL, list);
+
+    return g_list_sort_with_data (list, clientCompareRingKey, c);
 }
 
 void
@@ -440,6 +477,7 @@ clientSetLast(Client *c)
     screen_info = c->screen_info;
     if (screen_info->client_count > 2)
     {
+        c->ring_key = ++screen_info->ring_last;
         if (screen_info->clients == c)
         {
             screen_info->clients = screen_info->clients->next;
@@ -468,7 +506,7 @@ clientFocusNone (ScreenInfo *screen_info, Client *previous, guint32 timestamp)
     if (previous)
     {
         clientSetNetState (previous);
-        frameQueueDraw (previous, FALSE);
+        frameQueueDrawParts (previous, FRAME_DIRTY_STATE);
         if (previous->screen_info != screen_info)
         {
             clientSetNetActiveWindow (previous->screen_info, NULL, timestamp);
@@ -506,7 +544,7 @@ clientUpdateFocus (ScreenInfo *screen_info, Client * c, unsigned short flags)
     {
         clientSetNetState (c2);
         clientAdjustFullscreenLayer (c2, FALSE);
-        frameQueueDraw (c2, FALSE);
+        frameQueueDrawParts (c2, FRAME_DIRTY_STATE);
         clientUpdateOpacity (c2);
     }
     if (c)
@@ -530,7 +568,7 @@ clientUpdateFocus (ScreenInfo *screen_info, Client * c, unsigned short flags)
             clientRaise (c, None);
             clientSetLastRaise (c);
         }
-        frameQueueDraw (c, FALSE);
+        frameQueueDrawParts (c, FRAME_DIRTY_STATE);
         clientUpdateOpacity (c);
     }
     clientSetNetActiveWindow (screen_info, c, 0);
@@ -60,6 +60,8 @@ void                     clientPassFocus                        (ScreenInfo *,
 gboolean                 clientAcceptFocus                      (Client *);
 void                     clientSortRing                         (Client *);
 void                     clientSetLast                          (Client *);
+GList                   *clientSortRingList                     (Client *,
+                                                                 GList *);
 void                     clientUpdateFocus                      (ScreenInfo *,
                                                                  Client *,
                                                                  unsigned short);
@@ -25,6 +25,7 @@
 #include "config.h"
 #endif
 
+#include <string.h>
 #include <glib.h>
 #include <gdk/gdk.h>
 #include <gdk/gdkx.h>
@@ -45,6 +46,156 @@ typedef struct
     xfwmPixmap pm_sides[SIDE_COUNT];
 } FramePixmap;
 
+/* A side pixmap composed from the theme, shared by all frames of that size */
+struct _FrameTile
+{
+    /* Key */
+    gint side;
+    gint state;
+    gint width, height;
+    guint theme_generation;
+
+    guint ref_count;
+    xfwmPixmap pm;
+};
+
+static guint
+frame_tile_hash (gconstpointer key)
+{
+    const FrameTile *tile = key;
+
+    return ((tile->width << 16) ^ tile->height) ^
+           ((tile->theme_generation << 3) | (tile->side << 1) | tile->state);
+}
+
+static gboolean
+frame_tile_equal (gconstpointer a, gconstpointer b)
+{
+    const FrameTile *t1 = a;
+    const FrameTile *t2 = b;
+
+    return ((t1->side == t2->side) &&
+            (t1->state == t2->state) &&
+            (t1->width == t2->width) &&
+            (t1->height == t2->height) &&
+            (t1->theme_generation == t2->theme_generation));
+}
+
+void
+frameTilesInit (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+
+    screen_info->frame_tiles = g_hash_table_new (frame_tile_hash, frame_tile_equal);
+}
+
+void
+frameTilesClose (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+
+    if (screen_info->frame_tiles)
+    {
+        /* Clients are gone by now, hence all tiles */
+        g_hash_table_destroy (screen_info->frame_tiles);
+        screen_info->frame_tiles = NULL;
+    }
+}
+
+static void
+frameTileUnref (ScreenInfo *screen_info, FrameTile *tile)
+{
+    g_return_if_fail (tile->ref_count > 0);
+
+    if (--tile->ref_count > 0)
+    {
+        return;
+    }
+
+    g_hash_table_remove (screen_info->frame_tiles, tile);
+    xfwmPixmapFree (&tile->pm);
+    g_free (tile);
+}
+
+static FrameTile *
+frameTileRef (ScreenInfo *screen_info, int side, int state, int width, int height)
+{
+    FrameTile key;
+    FrameTile *tile;
+
+    key.side = side;
+    key.state = state;
+    key.width = width;
+    key.height = height;
+    key.theme_generation = screen_info->theme_generation;
+
+    tile = g_hash_table_lookup (screen_info->frame_tiles, &key);
+    if (tile)
+    {
+        tile->ref_count++;
+        return tile;
+    }
+
+    tile = g_new (FrameTile, 1);
+    *tile = key;
+    tile->ref_count = 1;
+    xfwmPixmapCreate (screen_info, &tile->pm, width, height);
+    xfwmPixmapFill (&screen_info->sides[side][state], &tile->pm, 0, 0, width, height);
+    g_hash_table_insert (screen_info->frame_tiles, tile, tile);
+
+    return tile;
+}
+
+void
+frameReleaseTiles (Client * c)
+{
+    int i, j;
+
+    g_return_if_fail (c);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    for (i = 0; i < SIDE_COUNT; i++)
+    {
+        for (j = 0; j < 2; j++)
+        {
+            if (c->side_tiles[i][j])
+            {
+                frameTileUnref (c->screen_info, c->side_tiles[i][j]);
+                c->side_tiles[i][j] = NULL;
+            }
+        }
+    }
+}
+
+/*
+ * Makes the client use the shared pixmap for the given side, and copies
+ * it in side_pm. The pixmap belongs to the tile and must not be freed.
+ * The tile of the other state is kept for frameSwapState().
+ */
+static void
+frameSetSideTile (Client * c, int side, int state, int width, int height, xfwmPixmap * side_pm)
+{
+    ScreenInfo *screen_info;
+    FrameTile *tile;
+
+    screen_info = c->screen_info;
+    tile = c->side_tiles[side][state];
+
+    if (!tile ||
+        tile->state != state || tile->width != width || tile->height != height ||
+        tile->theme_generation != screen_info->theme_generation)
+    {
+        /* Take the new one first so a tile shared with others is not freed */
+        tile = frameTileRef (screen_info, side, state, width, height);
+        if (c->side_tiles[side][state])
+        {
+            frameTileUnref (screen_info, c->side_tiles[side][state]);
+        }
+        c->side_tiles[side][state] = tile;
+    }
+    *side_pm = tile->pm;
+}
+
 int
 frameDecorationLeft (ScreenInfo *screen_info)
 {
@@ -380,10 +531,90 @@ frameFillTitlePixmap (Client * c, int state, int part, int x, int w, int h, xfwm
     xfwmPixmapFill (&screen_info->title[part][state], title_pm, x, 0, w, frameTop (c));
 }
 
+void
+frameInitTitleCache (Client * c)
+{
+    int i;
+
+    g_return_if_fail (c);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    c->title_layout = NULL;
+    c->title_layout_generation = 0;
+    c->title_layout_serial = 0;
+    for (i = 0; i < 2; i++)
+    {
+        c->title_cache[i].layout_serial = 0;
+        c->title_cache[i].theme_generation = 0;
+        xfwmPixmapInit (c->screen_info, &c->title_cache[i].title);
+        xfwmPixmapInit (c->screen_info, &c->title_cache[i].top);
+    }
+}
+
+void
+frameFreeTitleCache (Client * c)
+{
+    int i;
+
+    g_return_if_fail (c);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    if (c->title_layout)
+    {
+        g_object_unref (G_OBJECT (c->title_layout));
+        c->title_layout = NULL;
+    }
+    for (i = 0; i < 2; i++)
+    {
+        c->title_cache[i].layout_serial = 0;
+        xfwmPixmapFree (&c->title_cache[i].title);
+        xfwmPixmapFree (&c->title_cache[i].top);
+    }
+}
+
+static PangoLayout *
+frameGetTitleLayout (Client * c)
+{
+    ScreenInfo *screen_info;
+    PangoLayout *layout;
+
+    screen_info = c->screen_info;
+    if ((c->title_layout) &&
+        (c->title_layout_generation == screen_info->theme_generation) &&
+        (!g_strcmp0 (pango_layout_get_text (c->title_layout), c->name)))
+    {
+        return c->title_layout;
+    }
+
+    if (c->title_layout)
+    {
+        g_object_unref (G_OBJECT (c->title_layout));
+    }
+    layout = gtk_widget_create_pango_layout (myScreenGetGtkWidget (screen_info), c->name);
+    pango_layout_set_font_description (layout, myScreenGetFontDescription (screen_info));
+    pango_layout_set_auto_dir (layout, FALSE);
+
+    c->title_layout = layout;
+    c->title_layout_generation = screen_info->theme_generation;
+    /* Never 0, so that a fresh cache entry never matches */
+    if (++c->title_layout_serial == 0)
+    {
+        c->title_layout_serial = 1;
+    }
+
+    return layout;
+}
+
+/*
+ * Renders the title for the given state into c->title_cache[state], unless
+ * what is there already matches the title text, size and theme.
+ */
 static void
-frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap * title_pm, xfwmPixmap * top_pm)
+frameCreateTitlePixmap (Client * c, int state, int left, int right)
 {
     ScreenInfo *screen_info;
+    TitleCache *cache;
+    xfwmPixmap *title_pm, *top_pm;
     cairo_surface_t *surface;
     cairo_t *cr;
     PangoLayout *layout;
@@ -393,11 +624,12 @@ frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap *
     int title_height, top_height;
 
     g_return_if_fail (c);
-    g_return_if_fail (title_pm);
-    g_return_if_fail (top_pm);
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
     screen_info = c->screen_info;
+    cache = &c->title_cache[state];
+    title_pm = &cache->title;
+    top_pm = &cache->top;
 
     if (left > right)
     {
@@ -409,6 +641,9 @@ frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap *
     width = frameWidth (c) - frameTopLeftWidth (c, state) - frameTopRightWidth (c, state);
     if (width < 1)
     {
+        cache->layout_serial = 0;
+        xfwmPixmapFree (title_pm);
+        xfwmPixmapFree (top_pm);
         return;
     }
 
@@ -428,6 +663,25 @@ frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap *
     left = left - frameTopLeftWidth (c, state);
     right = right - frameTopLeftWidth (c, state);
 
+    layout = frameGetTitleLayout (c);
+    if ((cache->layout_serial == c->title_layout_serial) &&
+        (cache->theme_generation == screen_info->theme_generation) &&
+        (cache->width == width) && (cache->height == frameTop (c)) &&
+        (cache->left == left) && (cache->right == right))
+    {
+        TRACE ("title for client \"%s\" (0x%lx) is cached", c->name, c->window);
+        return;
+    }
+
+    xfwmPixmapFree (title_pm);
+    xfwmPixmapFree (top_pm);
+    cache->layout_serial = c->title_layout_serial;
+    cache->theme_generation = screen_info->theme_generation;
+    cache->width = width;
+    cache->height = frameTop (c);
+    cache->left = left;
+    cache->right = right;
+
     x = 0;
     hoffset = 0;
 
@@ -440,9 +694,6 @@ frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap *
         voffset = screen_info->params->title_vertical_offset_inactive;
     }
 
-    layout = gtk_widget_create_pango_layout (myScreenGetGtkWidget (screen_info), c->name);
-    pango_layout_set_font_description (layout, myScreenGetFontDescription (screen_info));
-    pango_layout_set_auto_dir (layout, FALSE);
     pango_layout_get_pixel_extents (layout, NULL, &logical_rect);
 
     title_height = screen_info->font_height;
@@ -592,7 +843,6 @@ frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap *
     }
     cairo_destroy (cr);
     cairo_surface_destroy (surface);
-    g_object_unref (G_OBJECT (layout));
 }
 
 static int
@@ -698,6 +948,129 @@ getLetterFromButton (int i, Client * c)
     return chr;
 }
 
+static void
+frameShapeAddRect (Client * c, XRectangle * rects, gint * n, gint x, gint y, gint width, gint height)
+{
+    gint x2, y2;
+
+    x2 = MIN (x + width, frameWidth (c));
+    y2 = MIN (y + height, frameHeight (c));
+    x = MAX (x, 0);
+    y = MAX (y, 0);
+    if ((x2 <= x) || (y2 <= y))
+    {
+        return;
+    }
+    rects[*n].x = x;
+    rects[*n].y = y;
+    rects[*n].width = x2 - x;
+    rects[*n].height = y2 - y;
+    (*n)++;
+}
+
+static void
+frameShapeAddWindow (Client * c, XRectangle * rects, gint * n, xfwmWindow * win)
+{
+    if (xfwmWindowVisible (win))
+    {
+        frameShapeAddRect (c, rects, n, win->x, win->y, win->width, win->height);
+    }
+}
+
+static gboolean
+frameShapeIsRectangles (Client * c, int state)
+{
+    ScreenInfo *screen_info;
+
+    screen_info = c->screen_info;
+    if (!screen_info->opaque_theme || FLAG_TEST (c->flags, CLIENT_FLAG_HAS_SHAPE))
+    {
+        return FALSE;
+    }
+
+    /* Tall corners need to be clipped against the opposite border */
+    if ((screen_info->corners[CORNER_TOP_LEFT][state].height > frameHeight (c) - frameBottom (c) + 1) ||
+        (screen_info->corners[CORNER_TOP_RIGHT][state].height > frameHeight (c) - frameBottom (c) + 1) ||
+        (screen_info->corners[CORNER_BOTTOM_LEFT][state].height > frameHeight (c) - frameTop (c) + 1) ||
+        (screen_info->corners[CORNER_BOTTOM_RIGHT][state].height > frameHeight (c) - frameTop (c) + 1))
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * With an opaque theme, the frame shape is just the union of the client
+ * area and the decoration windows, so set it from rectangles and skip
+ * the request entirely if it did not change since the last time.
+ */
+static void
+frameSetShapeRectangles (Client * c)
+{
+    ScreenInfo *screen_info;
+    DisplayInfo *display_info;
+    XRectangle rects[CLIENT_SHAPE_RECTS];
+    gint i, n;
+
+    screen_info = c->screen_info;
+    display_info = screen_info->display_info;
+
+    if (c->shape_generation != screen_info->theme_generation)
+    {
+        /* Drop the masks a previous full pass may have left behind */
+        XShapeCombineMask (display_info->dpy, MYWINDOW_XWINDOW (c->title),
+                           ShapeBounding, 0, 0, None, ShapeSet);
+        for (i = 0; i < SIDE_COUNT; i++)
+        {
+            XShapeCombineMask (display_info->dpy, MYWINDOW_XWINDOW (c->sides[i]),
+                               ShapeBounding, 0, 0, None, ShapeSet);
+        }
+        for (i = 0; i < CORNER_COUNT; i++)
+        {
+            XShapeCombineMask (display_info->dpy, MYWINDOW_XWINDOW (c->corners[i]),
+                               ShapeBounding, 0, 0, None, ShapeSet);
+        }
+        for (i = 0; i < BUTTON_COUNT; i++)
+        {
+            XShapeCombineMask (display_info->dpy, MYWINDOW_XWINDOW (c->buttons[i]),
+                               ShapeBounding, 0, 0, None, ShapeSet);
+        }
+        c->shape_nrects = -1;
+    }
+
+    n = 0;
+    if (!FLAG_TEST (c->flags, CLIENT_FLAG_SHADED))
+    {
+        frameShapeAddRect (c, rects, &n, frameLeft (c), frameTop (c), c->width, c->height);
+        frameShapeAddWindow (c, rects, &n, &c->sides[SIDE_LEFT]);
+        frameShapeAddWindow (c, rects, &n, &c->sides[SIDE_RIGHT]);
+    }
+    frameShapeAddWindow (c, rects, &n, &c->title);
+    frameShapeAddWindow (c, rects, &n, &c->sides[SIDE_TOP]);
+    frameShapeAddWindow (c, rects, &n, &c->sides[SIDE_BOTTOM]);
+    for (i = 0; i < CORNER_COUNT; i++)
+    {
+        frameShapeAddWindow (c, rects, &n, &c->corners[i]);
+    }
+    for (i = 0; i < BUTTON_COUNT; i++)
+    {
+        frameShapeAddWindow (c, rects, &n, &c->buttons[i]);
+    }
+
+    if ((n == c->shape_nrects) && !memcmp (rects, c->shape_rects, n * sizeof (XRectangle)))
+    {
+        TRACE ("shape of client \"%s\" (0x%lx) unchanged", c->name, c->window);
+        return;
+    }
+
+    XShapeCombineRectangles (display_info->dpy, c->frame, ShapeBounding, 0, 0,
+                             rects, n, ShapeSet, Unsorted);
+    memcpy (c->shape_rects, rects, n * sizeof (XRectangle));
+    c->shape_nrects = n;
+    c->shape_generation = screen_info->theme_generation;
+}
+
 static void
 frameSetShape (Client * c, int state, FramePixmap * frame_pix, int button_x[BUTTON_COUNT])
 {
@@ -718,6 +1091,13 @@ frameSetShape (Client * c, int state, FramePixmap * frame_pix, int button_x[BUTT
         return;
     }
 
+    if (frame_pix && frameShapeIsRectangles (c, state))
+    {
+        frameSetShapeRectangles (c);
+        return;
+    }
+    c->shape_generation = 0;
+
     if (screen_info->shape_win == None)
     {
         screen_info->shape_win = XCreateSimpleWindow (display_info->dpy, screen_info->xroot, 0, 0, frameWidth (c), frameHeight (c), 0, 0, 0);
@@ -979,6 +1359,180 @@ frameSetShapeInput (Client * c)
     XShapeCombineShape(display_info->dpy, c->frame, ShapeInput, 0, 0, screen_info->shape_win, ShapeInput, ShapeSet);
 }
 
+/*
+ * Redraws only the buttons and/or the title strip, the frame layout being
+ * unchanged. Returns FALSE if a full redraw is needed instead.
+ */
+static gboolean
+frameDrawParts (Client * c, int state, guint dirty)
+{
+    ScreenInfo *screen_info;
+    FramePixmap frame_pix;
+    TitleCache *cache;
+    xfwmPixmap *my_pixmap;
+    gint button_x[BUTTON_COUNT];
+    gint i;
+
+    screen_info = c->screen_info;
+    cache = &c->title_cache[state];
+
+    if ((dirty & FRAME_DIRTY_TITLE) && (cache->layout_serial == 0))
+    {
+        /* Title was never rendered for this state */
+        return FALSE;
+    }
+
+    for (i = 0; i < BUTTON_COUNT; i++)
+    {
+        if (!(dirty & FRAME_DIRTY_BUTTON (i)) || !xfwmWindowVisible (&c->buttons[i]))
+        {
+            continue;
+        }
+        my_pixmap = clientGetButtonPixmap (c, i, clientGetButtonState (c, i, state));
+        if (!xfwmPixmapNone(my_pixmap))
+        {
+            xfwmWindowSetBG (&c->buttons[i], my_pixmap);
+        }
+        xfwmWindowShow (&c->buttons[i], c->buttons[i].x, c->buttons[i].y,
+            c->buttons[i].width, c->buttons[i].height, TRUE);
+        /* The state pixmaps may not share the same mask */
+        dirty |= FRAME_DIRTY_SHAPE;
+    }
+
+    if (dirty & FRAME_DIRTY_TITLE)
+    {
+        frameCreateTitlePixmap (c, state,
+            cache->left + frameTopLeftWidth (c, state),
+            cache->right + frameTopLeftWidth (c, state));
+        xfwmWindowSetBG (&c->title, &cache->title);
+        xfwmWindowShow (&c->title, c->title.x, c->title.y,
+            c->title.width, c->title.height, TRUE);
+        if (xfwmWindowVisible (&c->sides[SIDE_TOP]) && !xfwmPixmapNone (&cache->top))
+        {
+            xfwmWindowSetBG (&c->sides[SIDE_TOP], &cache->top);
+            xfwmWindowShow (&c->sides[SIDE_TOP], c->sides[SIDE_TOP].x, c->sides[SIDE_TOP].y,
+                c->sides[SIDE_TOP].width, c->sides[SIDE_TOP].height, TRUE);
+        }
+        dirty |= FRAME_DIRTY_SHAPE;
+    }
+
+    if (dirty & FRAME_DIRTY_SHAPE)
+    {
+        /* Everything frameSetShape() needs is still around */
+        frame_pix.pm_title = cache->title;
+        frame_pix.pm_sides[SIDE_TOP] = cache->top;
+        for (i = 0; i < SIDE_COUNT; i++)
+        {
+            if (i == SIDE_TOP)
+            {
+                continue;
+            }
+            if (c->side_tiles[i][state])
+            {
+                frame_pix.pm_sides[i] = c->side_tiles[i][state]->pm;
+            }
+            else
+            {
+                xfwmPixmapInit (screen_info, &frame_pix.pm_sides[i]);
+            }
+        }
+        for (i = 0; i < BUTTON_COUNT; i++)
+        {
+            button_x[i] = c->buttons[i].x;
+        }
+        frameSetShape (c, state, &frame_pix, button_x);
+    }
+
+    return TRUE;
+}
+
+static void
+frameSwapWindowBG (xfwmWindow * win, xfwmPixmap * pm)
+{
+    if (!xfwmWindowVisible (win))
+    {
+        return;
+    }
+    if (!xfwmPixmapNone (pm))
+    {
+        xfwmWindowSetBG (win, pm);
+    }
+    xfwmWindowShow (win, win->x, win->y, win->width, win->height, TRUE);
+}
+
+/*
+ * Focus changes only switch between the ACTIVE and INACTIVE pixmaps.
+ * When the theme gives both states the same geometry, the part windows
+ * stay where they are and only get the background of the other state.
+ * The title pixmaps and side tiles of both states are kept around, so
+ * after the first switch this needs no rendering at all.
+ */
+static gboolean
+frameSwapState (Client * c, int state)
+{
+    ScreenInfo *screen_info;
+    FramePixmap frame_pix;
+    TitleCache *drawn, *cache;
+    xfwmPixmap *my_pixmap;
+    gint button_x[BUTTON_COUNT];
+    gint i;
+
+    screen_info = c->screen_info;
+    drawn = &c->title_cache[(state == ACTIVE) ? INACTIVE : ACTIVE];
+    cache = &c->title_cache[state];
+
+    if (!screen_info->dual_state || (drawn->layout_serial == 0) ||
+        (drawn->theme_generation != screen_info->theme_generation))
+    {
+        return FALSE;
+    }
+    TRACE ("client \"%s\" (0x%lx) to state %i", c->name, c->window, state);
+
+    /* A no-op unless the title changed since it was last rendered in this state */
+    frameCreateTitlePixmap (c, state,
+        drawn->left + frameTopLeftWidth (c, state),
+        drawn->right + frameTopLeftWidth (c, state));
+    frame_pix.pm_title = cache->title;
+    frame_pix.pm_sides[SIDE_TOP] = cache->top;
+    frameSwapWindowBG (&c->title, &cache->title);
+    frameSwapWindowBG (&c->sides[SIDE_TOP], &cache->top);
+
+    for (i = 0; i < SIDE_COUNT; i++)
+    {
+        if (i == SIDE_TOP)
+        {
+            continue;
+        }
+        if (!xfwmWindowVisible (&c->sides[i]))
+        {
+            xfwmPixmapInit (screen_info, &frame_pix.pm_sides[i]);
+            continue;
+        }
+        frameSetSideTile (c, i, state, c->sides[i].width, c->sides[i].height,
+            &frame_pix.pm_sides[i]);
+        frameSwapWindowBG (&c->sides[i], &frame_pix.pm_sides[i]);
+    }
+
+    for (i = 0; i < CORNER_COUNT; i++)
+    {
+        frameSwapWindowBG (&c->corners[i], &screen_info->corners[i][state]);
+    }
+
+    for (i = 0; i < BUTTON_COUNT; i++)
+    {
+        button_x[i] = c->buttons[i].x;
+        if (xfwmWindowVisible (&c->buttons[i]))
+        {
+            my_pixmap = clientGetButtonPixmap (c, i, clientGetButtonState (c, i, state));
+            frameSwapWindowBG (&c->buttons[i], my_pixmap);
+        }
+    }
+
+    frameSetShape (c, state, &frame_pix, button_x);
+
+    return TRUE;
+}
+
 static void
 frameDrawWin (Client * c)
 {
@@ -990,13 +1544,17 @@ frameDrawWin (Client * c)
     gint button_x[BUTTON_COUNT];
     guint i, j;
     gboolean requires_clearing;
+    gboolean state_changed;
     gboolean width_changed;
     gboolean height_changed;
+    guint dirty;
 
     g_return_if_fail (c != NULL);
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
     frameClearQueueDraw (c);
+    dirty = c->frame_dirty;
+    c->frame_dirty = 0;
 
     screen_info = c->screen_info;
     requires_clearing = FALSE;
@@ -1037,6 +1595,7 @@ frameDrawWin (Client * c)
         requires_clearing = TRUE;
         FLAG_SET (c->xfwm_flags,  XFWM_FLAG_DRAW_ACTIVE);
     }
+    state_changed = requires_clearing && !FLAG_TEST (c->xfwm_flags, XFWM_FLAG_FIRST_MAP);
     /* Flag clearance */
     FLAG_UNSET (c->xfwm_flags,  XFWM_FLAG_FIRST_MAP);
 
@@ -1062,6 +1621,24 @@ frameDrawWin (Client * c)
         }
     }
 
+    if (CLIENT_HAS_FRAME (c) && !requires_clearing && !width_changed && !height_changed &&
+        !(dirty & ~(FRAME_DIRTY_TITLE | FRAME_DIRTY_BUTTONS | FRAME_DIRTY_STATE)))
+    {
+        if (frameDrawParts (c, state, dirty))
+        {
+            return;
+        }
+    }
+
+    if (CLIENT_HAS_FRAME (c) && state_changed && !width_changed && !height_changed &&
+        !(dirty & ~(FRAME_DIRTY_TITLE | FRAME_DIRTY_BUTTONS | FRAME_DIRTY_STATE)))
+    {
+        if (frameSwapState (c, state))
+        {
+            return;
+        }
+    }
+
     if (CLIENT_HAS_FRAME (c))
     {
         /* First, hide the buttons that we don't have... */
@@ -1158,14 +1735,14 @@ frameDrawWin (Client * c)
         right_height = frameHeight (c) - frameTop (c) -
             screen_info->corners[CORNER_BOTTOM_RIGHT][state].height;
 
-        xfwmPixmapInit (screen_info, &frame_pix.pm_title);
-        xfwmPixmapInit (screen_info, &frame_pix.pm_sides[SIDE_TOP]);
         xfwmPixmapInit (screen_info, &frame_pix.pm_sides[SIDE_BOTTOM]);
         xfwmPixmapInit (screen_info, &frame_pix.pm_sides[SIDE_LEFT]);
         xfwmPixmapInit (screen_info, &frame_pix.pm_sides[SIDE_RIGHT]);
 
         /* The title is always visible */
-        frameCreateTitlePixmap (c, state, left, right, &frame_pix.pm_title, &frame_pix.pm_sides[SIDE_TOP]);
+        frameCreateTitlePixmap (c, state, left, right);
+        frame_pix.pm_title = c->title_cache[state].title;
+        frame_pix.pm_sides[SIDE_TOP] = c->title_cache[state].top;
         xfwmWindowSetBG (&c->title, &frame_pix.pm_title);
         xfwmWindowShow (&c->title,
             frameTopLeftWidth (c, state), 0, top_width,
@@ -1205,21 +1782,15 @@ frameDrawWin (Client * c)
             }
             else
             {
-                xfwmPixmapCreate (screen_info, &frame_pix.pm_sides[SIDE_LEFT],
-                    frameLeft (c), left_height);
-                xfwmPixmapFill (&screen_info->sides[SIDE_LEFT][state],
-                    &frame_pix.pm_sides[SIDE_LEFT],
-                    0, 0, frameLeft (c), left_height);
+                frameSetSideTile (c, SIDE_LEFT, state, frameLeft (c), left_height,
+                    &frame_pix.pm_sides[SIDE_LEFT]);
                 xfwmWindowSetBG (&c->sides[SIDE_LEFT],
                     &frame_pix.pm_sides[SIDE_LEFT]);
                 xfwmWindowShow (&c->sides[SIDE_LEFT], 0, frameTop (c),
                     frameLeft (c), left_height, (requires_clearing | height_changed));
 
-                xfwmPixmapCreate (screen_info, &frame_pix.pm_sides[SIDE_RIGHT],
-                    frameRight (c), right_height);
-                xfwmPixmapFill (&screen_info->sides[SIDE_RIGHT][state],
-                    &frame_pix.pm_sides[SIDE_RIGHT],
-                    0, 0, frameRight (c), right_height);
+                frameSetSideTile (c, SIDE_RIGHT, state, frameRight (c), right_height,
+                    &frame_pix.pm_sides[SIDE_RIGHT]);
                 xfwmWindowSetBG (&c->sides[SIDE_RIGHT],
                     &frame_pix.pm_sides[SIDE_RIGHT]);
                 xfwmWindowShow (&c->sides[SIDE_RIGHT],
@@ -1227,11 +1798,8 @@ frameDrawWin (Client * c)
                     right_height, (requires_clearing | height_changed));
             }
 
-            xfwmPixmapCreate (screen_info, &frame_pix.pm_sides[SIDE_BOTTOM],
-                bottom_width, frameBottom (c));
-            xfwmPixmapFill (&screen_info->sides[SIDE_BOTTOM][state],
-                &frame_pix.pm_sides[SIDE_BOTTOM],
-                0, 0, bottom_width, frameBottom (c));
+            frameSetSideTile (c, SIDE_BOTTOM, state, bottom_width, frameBottom (c),
+                &frame_pix.pm_sides[SIDE_BOTTOM]);
             xfwmWindowSetBG (&c->sides[SIDE_BOTTOM],
                 &frame_pix.pm_sides[SIDE_BOTTOM]);
             xfwmWindowShow (&c->sides[SIDE_BOTTOM],
@@ -1279,13 +1847,8 @@ frameDrawWin (Client * c)
                 screen_info->corners[CORNER_BOTTOM_RIGHT][state].height,
                 requires_clearing);
         }
+        /* All pixmaps in frame_pix are owned by the title cache or the tiles */
         frameSetShape (c, state, &frame_pix, button_x);
-
-        xfwmPixmapFree (&frame_pix.pm_title);
-        xfwmPixmapFree (&frame_pix.pm_sides[SIDE_TOP]);
-        xfwmPixmapFree (&frame_pix.pm_sides[SIDE_BOTTOM]);
-        xfwmPixmapFree (&frame_pix.pm_sides[SIDE_LEFT]);
-        xfwmPixmapFree (&frame_pix.pm_sides[SIDE_RIGHT]);
     }
     else
     {
@@ -1318,17 +1881,67 @@ frameDrawWin (Client * c)
     }
 }
 
+static gboolean
+frameQueueRun (Client * c, gint64 deadline)
+{
+    frameDrawWin (c);
+
+    return (g_get_monotonic_time () < deadline);
+}
+
 static gboolean
 update_frame_idle_cb (gpointer data)
 {
+    ScreenInfo *screen_info;
     Client *c;
+    GList *list, *prev;
+    gint64 deadline;
+    gint pass;
 
-    c = (Client *) data;
-    g_return_val_if_fail (c, FALSE);
-    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+    screen_info = (ScreenInfo *) data;
+    g_return_val_if_fail (screen_info, FALSE);
+    TRACE ("%i frames queued", g_list_length (screen_info->frame_queue));
 
-    frameDrawWin (c);
-    c->frame_timeout_id = 0;
+    deadline = g_get_monotonic_time () + FRAME_QUEUE_BUDGET;
+
+    /* Visible frames first, from the top of the stack down */
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (list = g_list_last (screen_info->windows_stack); list; list = prev)
+        {
+            prev = g_list_previous (list);
+            c = (Client *) list->data;
+            if (!c->frame_queued)
+            {
+                continue;
+            }
+            if ((pass == 0) && !FLAG_TEST (c->xfwm_flags, XFWM_FLAG_VISIBLE))
+            {
+                continue;
+            }
+            if (!frameQueueRun (c, deadline))
+            {
+                goto out;
+            }
+        }
+    }
+
+    /* Anything not stacked (yet) */
+    while (screen_info->frame_queue)
+    {
+        if (!frameQueueRun ((Client *) screen_info->frame_queue->data, deadline))
+        {
+            goto out;
+        }
+    }
+
+out:
+    XFlush (myScreenGetXDisplay (screen_info));
+    if (screen_info->frame_queue)
+    {
+        return (TRUE);
+    }
+    screen_info->frame_queue_id = 0;
 
     return (FALSE);
 }
@@ -1336,13 +1949,23 @@ update_frame_idle_cb (gpointer data)
 void
 frameClearQueueDraw (Client * c)
 {
+    ScreenInfo *screen_info;
+
     g_return_if_fail (c);
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
-    if (c->frame_timeout_id)
+    if (!c->frame_queued)
     {
-        g_source_remove (c->frame_timeout_id);
-        c->frame_timeout_id = 0;
+        return;
+    }
+
+    screen_info = c->screen_info;
+    screen_info->frame_queue = g_list_remove (screen_info->frame_queue, c);
+    c->frame_queued = FALSE;
+    if (!screen_info->frame_queue && screen_info->frame_queue_id)
+    {
+        g_source_remove (screen_info->frame_queue_id);
+        screen_info->frame_queue_id = 0;
     }
 }
 
@@ -1356,6 +1979,7 @@ frameDraw (Client * c, gboolean clear_all)
     {
         FLAG_SET (c->xfwm_flags, XFWM_FLAG_NEEDS_REDRAW);
     }
+    c->frame_dirty = FRAME_DIRTY_ALL;
     frameDrawWin (c);
 }
 
@@ -1365,20 +1989,36 @@ frameQueueDraw (Client * c, gboolean clear_all)
     g_return_if_fail (c);
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
-    /* Reschedule update */
-    if (c->frame_timeout_id)
-    {
-        frameClearQueueDraw (c);
-    }
     if (clear_all)
     {
         FLAG_SET (c->xfwm_flags, XFWM_FLAG_NEEDS_REDRAW);
     }
+    frameQueueDrawParts (c, FRAME_DIRTY_ALL);
+}
+
+void
+frameQueueDrawParts (Client * c, guint parts)
+{
+    ScreenInfo *screen_info;
+
+    g_return_if_fail (c);
+    TRACE ("client \"%s\" (0x%lx) parts 0x%x", c->name, c->window, parts);
+
+    c->frame_dirty |= parts;
+
     /* Otherwise leave previous schedule */
-    if (c->frame_timeout_id == 0)
+    if (c->frame_queued)
+    {
+        return;
+    }
+
+    screen_info = c->screen_info;
+    screen_info->frame_queue = g_list_prepend (screen_info->frame_queue, c);
+    c->frame_queued = TRUE;
+    if (screen_info->frame_queue_id == 0)
     {
-        c->frame_timeout_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-                                              update_frame_idle_cb, c, NULL);
+        screen_info->frame_queue_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                                                       update_frame_idle_cb, screen_info, NULL);
     }
 }
 
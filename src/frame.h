@@ -32,6 +32,21 @@
 #include "mypixmap.h"
 #include "client.h"
 
+/* Parts of the frame to redraw, see frameQueueDrawParts() */
+#define FRAME_DIRTY_TITLE               (1<<0)
+#define FRAME_DIRTY_SIDES               (1<<1)
+#define FRAME_DIRTY_CORNERS             (1<<2)
+#define FRAME_DIRTY_SHAPE               (1<<3)
+#define FRAME_DIRTY_BUTTON(b)           (1<<(4 + (b)))
+#define FRAME_DIRTY_BUTTONS             (((1<<BUTTON_COUNT) - 1) << 4)
+#define FRAME_DIRTY_STATE               (1<<(4 + BUTTON_COUNT))
+#define FRAME_DIRTY_ALL                 (~0U)
+
+/* Time spent redrawing queued frames per main loop iteration */
+#ifndef FRAME_QUEUE_BUDGET
+#define FRAME_QUEUE_BUDGET              4000 /* usec */
+#endif
+
 int                      frameDecorationLeft                    (ScreenInfo *);
 int                      frameDecorationRight                   (ScreenInfo *);
 int                      frameDecorationTop                     (ScreenInfo *);
@@ -52,10 +67,17 @@ int                      frameExtentX                           (Client *);
 int                      frameExtentY                           (Client *);
 int                      frameExtentWidth                       (Client *);
 int                      frameExtentHeight                      (Client *);
+void                     frameTilesInit                         (ScreenInfo *);
+void                     frameTilesClose                        (ScreenInfo *);
+void                     frameReleaseTiles                      (Client *);
 void                     frameSetShapeInput                     (Client *);
+void                     frameInitTitleCache                    (Client *);
+void                     frameFreeTitleCache                    (Client *);
 void                     frameClearQueueDraw                    (Client *);
 void                     frameQueueDraw                         (Client *,
                                                                  gboolean);
+void                     frameQueueDrawParts                    (Client *,
+                                                                 guint);
 void                     frameDraw                              (Client *,
                                                                  gboolean);
 
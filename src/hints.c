@@ -1095,18 +1095,22 @@ getKDEIcon (DisplayInfo *display_info, Window window, Pixmap * pixmap, Pixmap *
     return TRUE;
 }
 
+/*
+ * Reads length items of _NET_WM_ICON from offset (both in 32-bit items),
+ * bytes_after tells how much of the property is left beyond that.
+ */
 gboolean
-getRGBIconData (DisplayInfo *display_info, Window window, unsigned long **data, unsigned long *nitems)
+getRGBIconData (DisplayInfo *display_info, Window window, long offset, long length,
+                unsigned long **data, unsigned long *nitems, unsigned long *bytes_after)
 {
     Atom type;
     int format;
-    unsigned long bytes_after;
 
-    TRACE ("window 0x%lx", window);
+    TRACE ("window 0x%lx offset %li length %li", window, offset, length);
 
     if (XGetWindowProperty (display_info->dpy, window, display_info->atoms[NET_WM_ICON],
-                            0L, G_MAXLONG, FALSE, XA_CARDINAL, &type, &format, nitems,
-                            &bytes_after, (unsigned char **) data) != Success)
+                            offset, length, FALSE, XA_CARDINAL, &type, &format, nitems,
+                            bytes_after, (unsigned char **) data) != Success)
     {
         *data = NULL;
         return FALSE;
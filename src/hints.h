@@ -262,7 +262,10 @@ gboolean                 getKDEIcon                             (DisplayInfo *,
                                                                  Pixmap *);
 gboolean                 getRGBIconData                         (DisplayInfo *,
                                                                  Window,
+                                                                 long,
+                                                                 long,
                                                                  unsigned long **,
+                                                                 unsigned long *,
                                                                  unsigned long *);
 gboolean                 getOpacity                             (DisplayInfo *,
                                                                  Window,
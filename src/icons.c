@@ -43,6 +43,34 @@
 #include "client.h"
 #include "compositor.h"
 #include "hints.h"
+#include "pixel.h"
+
+/* Most _NET_WM_ICON sizes looked at */
+#ifndef ICON_MAX_SIZES
+#define ICON_MAX_SIZES                  64
+#endif
+
+/* Most decoded sizes kept per client, see getCachedAppIcon() */
+#ifndef ICON_CACHE_SIZE
+#define ICON_CACHE_SIZE                 4
+#endif
+
+typedef struct
+{
+    guint width;
+    guint height;
+    /* Where the pixels start, in 32-bit items */
+    glong offset;
+}
+IconSize;
+
+typedef struct
+{
+    guint width;
+    guint height;
+    GdkPixbuf *pixbuf;
+}
+IconCacheEntry;
 
 static void
 downsize_ratio (guint *width, guint *height, guint dest_w, guint dest_h)
@@ -103,99 +131,87 @@ default_icon_at_size (GdkScreen *screen, guint width, guint height)
 }
 
 
-static gboolean
-find_largest_sizes (gulong * data, gulong nitems, guint *width, guint *height)
+/*
+ * Walks the _NET_WM_ICON headers without transferring the pixels, some
+ * applications publish icon sets of a megabyte or more and only one of
+ * the sizes is ever needed.
+ */
+static GArray *
+read_rgb_icon_sizes (DisplayInfo *display_info, Window window)
 {
-    guint w, h;
+    GArray *sizes;
+    IconSize size;
+    gulong *data;
+    gulong nitems, bytes_after;
+    guint64 len;
+    glong offset;
 
-    *width = 0;
-    *height = 0;
+    sizes = g_array_new (FALSE, FALSE, sizeof (IconSize));
+    offset = 0;
 
-    while (nitems > 0)
+    while (sizes->len < ICON_MAX_SIZES)
     {
-        if (nitems < 3)
+        if (!getRGBIconData (display_info, window, offset, 2, &data, &nitems, &bytes_after))
         {
-            return FALSE;       /* no space for w, h */
+            break;
+        }
+        if (nitems < 2)
+        {
+            if (data)
+            {
+                XFree (data);
+            }
+            break;
         }
 
-        w = data[0];
-        h = data[1];
+        size.width = data[0];
+        size.height = data[1];
+        size.offset = offset + 2;
+        XFree (data);
 
-        if (nitems < (gulong) ((w * h) + 2))
+        len = (guint64) size.width * size.height;
+        if ((len == 0) || (len > bytes_after / 4))
         {
-            return FALSE;       /* not enough data */
+            break;              /* not enough data */
         }
+        g_array_append_val (sizes, size);
 
-        *width = MAX (w, *width);
-        *height = MAX (h, *height);
-
-        data += (w * h) + 2;
-        nitems -= (w * h) + 2;
+        if (len == bytes_after / 4)
+        {
+            break;              /* that was the last one */
+        }
+        offset += len + 2;
     }
 
-    return TRUE;
+    return sizes;
 }
 
-static gboolean
-find_best_size (gulong * data, gulong nitems, gint ideal_width, gint ideal_height,
-                guint *width, guint *height, gulong ** start)
+static IconSize *
+find_best_size (GArray *sizes, guint ideal_width, guint ideal_height)
 {
-    gulong *best_start;
-    guint ideal_size;
-    guint w, h, best_size, this_size;
-    guint best_w, best_h, max_width, max_height;
-
-    *width = 0;
-    *height = 0;
-    *start = NULL;
-
-    if (!find_largest_sizes (data, nitems, &max_width, &max_height))
-    {
-        return FALSE;
-    }
-
-    if (ideal_width < 0)
-    {
-        ideal_width = max_width;
-    }
-    if (ideal_height < 0)
-    {
-        ideal_height = max_height;
-    }
+    IconSize *best, *this;
+    guint ideal_size, best_size, this_size;
+    guint i;
 
-    best_w = 0;
-    best_h = 0;
-    best_start = NULL;
+    best = NULL;
+    ideal_size = (ideal_width + ideal_height) / 2;
 
-    while (nitems > 0)
+    for (i = 0; i < sizes->len; i++)
     {
         gboolean replace;
 
+        this = &g_array_index (sizes, IconSize, i);
         replace = FALSE;
 
-        if (nitems < 3)
-        {
-            return FALSE;       /* no space for w, h */
-        }
-
-        w = data[0];
-        h = data[1];
-
-        if (nitems < (gulong) ((w * h) + 2))
-        {
-            break;              /* not enough data */
-        }
-
-        if (best_start == NULL)
+        if (best == NULL)
         {
             replace = TRUE;
         }
         else
         {
             /* work with averages */
-            ideal_size = (ideal_width + ideal_height) / 2;
-            best_size = (best_w + best_h) / 2;
-            this_size = (w + h) / 2;
+            best_size = (best->width + best->height) / 2;
+            this_size = (this->width + this->height) / 2;
 
             if ((best_size < ideal_size) && (this_size >= ideal_size))
             {
@@ -216,70 +232,52 @@ find_best_size (gulong * data, gulong nitems, gint ideal_width, gint ideal_heigh
 
         if (replace)
         {
-            best_start = data + 2;
-            best_w = w;
-            best_h = h;
+            best = this;
         }
-
-        data += (w * h) + 2;
-        nitems -= (w * h) + 2;
     }
 
-    if (best_start)
-    {
-        *start = best_start;
-        *width = best_w;
-        *height = best_h;
-        return TRUE;
-    }
-
-    return FALSE;
+    return best;
 }
 
 static void
 argbdata_to_pixdata (gulong * argb_data, guint len, guchar ** pixdata)
 {
-    guchar *p;
-    guint argb;
-    guint rgba;
-    guint i;
-
     *pixdata = g_new (guchar, len * 4);
-    p = *pixdata;
-
-    i = 0;
-    while (i < len)
-    {
-        argb = argb_data[i];
-        rgba = (argb << 8) | (argb >> 24);
-
-        *p = rgba >> 24; ++p;
-        *p = (rgba >> 16) & 0xff; ++p;
-        *p = (rgba >> 8) & 0xff; ++p;
-        *p = rgba & 0xff; ++p;
-
-        ++i;
-    }
+    pixelArgbToRgba (argb_data, *pixdata, len);
 }
 
 static gboolean
 read_rgb_icon (DisplayInfo *display_info, Window window, guint ideal_width, guint ideal_height,
                guint *width, guint *height, guchar ** pixdata)
 {
-    gulong nitems;
+    GArray *sizes;
+    IconSize *best;
+    gulong nitems, bytes_after;
     gulong *data;
-    gulong *best;
     guint w, h;
+    glong offset;
 
-    data = NULL;
-
-    if (!getRGBIconData (display_info, window, &data, &nitems))
+    sizes = read_rgb_icon_sizes (display_info, window);
+    best = find_best_size (sizes, ideal_width, ideal_height);
+    if (!best)
     {
+        g_array_free (sizes, TRUE);
         return FALSE;
     }
+    w = best->width;
+    h = best->height;
+    offset = best->offset;
+    g_array_free (sizes, TRUE);
 
-    if (!find_best_size (data, nitems, ideal_width, ideal_height, &w, &h, &best))
+    /* Only transfer the pixels of the size we picked */
+    data = NULL;
+    if (!getRGBIconData (display_info, window, offset, (glong) w * h, &data, &nitems, &bytes_after))
     {
+        return FALSE;
+    }
+    if (nitems < (gulong) w * h)
+    {
+        /* The property changed in between */
         XFree (data);
         return FALSE;
     }
@@ -287,7 +285,7 @@ read_rgb_icon (DisplayInfo *display_info, Window window, guint ideal_width, guin
     *width = w;
     *height = h;
 
-    argbdata_to_pixdata (best, w * h, pixdata);
+    argbdata_to_pixdata (data, w * h, pixdata);
 
     XFree (data);
 
@@ -352,13 +350,21 @@ apply_mask (GdkPixbuf * pixbuf, GdkPixbuf * mask)
     i = 0;
     while (i < h)
     {
-        j = 0;
-        while (j < w)
+        guchar *s = src + i * src_stride;
+        guchar *d = dest + i * dest_stride;
+
+        if (src_bpx == 4)
         {
-            guchar *s = src + i * src_stride + j * src_bpx;
-            guchar *d = dest + i * dest_stride + j * dest_bpx;
-            d[dest_bpx - 1] = s[src_bpx - 1];
-            ++j;
+            pixelCopyAlpha (s, d, w);
+        }
+        else
+        {
+            j = 0;
+            while (j < w)
+            {
+                d[j * dest_bpx + dest_bpx - 1] = s[j * src_bpx + src_bpx - 1];
+                ++j;
+            }
         }
         ++i;
     }
@@ -562,68 +568,156 @@ getAppIcon (ScreenInfo *screen_info, Window window, guint width, guint height)
     return default_icon_at_size (screen_info->gscr, width, height);
 }
 
-GdkPixbuf *
-getClientIcon (Client *c, guint width, guint height)
+/*
+ * Returns a preview of the client that stays on the X server, the window
+ * pixmap scaled by the compositor is never read back, only the small
+ * application icon drawn over it is uploaded.
+ */
+cairo_surface_t *
+getClientPreview (Client *c, guint width, guint height)
 {
+#ifdef HAVE_COMPOSITOR
     ScreenInfo *screen_info;
-    GdkPixbuf *app_content;
+    DisplayInfo *display_info;
+    XRenderPictFormat *render_format;
+    cairo_surface_t *content;
+    cairo_surface_t *surface;
+    cairo_t *cr;
     GdkPixbuf *small_icon;
-    GdkPixbuf *icon_pixbuf;
-    GdkPixbuf *icon_pixbuf_stated;
     guint small_icon_size;
-    guint app_icon_width, app_icon_height;
+    guint content_width, content_height;
+    gint x, y;
     Pixmap pixmap;
 
     g_return_val_if_fail (c != NULL, NULL);
 
     screen_info = c->screen_info;
-    icon_pixbuf = NULL;
-    app_icon_width = width; /* Set to 0 to use gdk pixbuf scaling */
-    app_icon_height = height; /* Set to 0 to use gdk pixbuf scaling */
+    display_info = screen_info->display_info;
+    content_width = width;
+    content_height = height;
+
+    pixmap = compositorGetWindowPixmapAtSize (screen_info, c->frame, &content_width, &content_height);
+    if (pixmap == None)
+    {
+        return NULL;
+    }
 
-    icon_pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, width, height);
-    gdk_pixbuf_fill (icon_pixbuf, 0x00);
+    render_format = XRenderFindStandardFormat (display_info->dpy, PictStandardARGB32);
+    content = cairo_xlib_surface_create_with_xrender_format (display_info->dpy,
+                                                             pixmap,
+                                                             screen_info->xscreen,
+                                                             render_format,
+                                                             content_width, content_height);
+    /* Same screen and format, so that one is a pixmap as well */
+    surface = cairo_surface_create_similar (content, CAIRO_CONTENT_COLOR_ALPHA, width, height);
 
-    pixmap = compositorGetWindowPixmapAtSize (screen_info, c->frame, &app_icon_width, &app_icon_height);
-    if (pixmap != None)
+    x = (width - content_width) / 2;
+    y = (height - content_height) / 2;
+
+    cr = cairo_create (surface);
+    cairo_set_source_surface (cr, content, x, y);
+    cairo_paint (cr);
+
+    if (FLAG_TEST (c->flags, CLIENT_FLAG_ICONIFIED))
     {
-        app_content = try_pixmap_and_mask (screen_info, pixmap, None, width, height);
-        XFreePixmap (myScreenGetXDisplay (screen_info), pixmap);
+        /* Takes 45% of the saturation away, as the icon used to */
+        cairo_save (cr);
+        cairo_rectangle (cr, x, y, content_width, content_height);
+        cairo_clip (cr);
+        cairo_set_operator (cr, CAIRO_OPERATOR_HSL_SATURATION);
+        cairo_set_source_rgb (cr, 0.5, 0.5, 0.5);
+        cairo_paint_with_alpha (cr, 0.45);
+        cairo_restore (cr);
     }
-    else
+
+    small_icon_size = MIN (width / 4, height / 4);
+    small_icon_size = MIN (small_icon_size, 48);
+
+    small_icon = getCachedAppIcon (c, small_icon_size, small_icon_size);
+    if (small_icon)
+    {
+        gdk_cairo_set_source_pixbuf (cr, small_icon,
+                                     (width - small_icon_size) / 2, height - small_icon_size);
+        cairo_paint (cr);
+        g_object_unref (small_icon);
+    }
+    cairo_destroy (cr);
+
+    cairo_surface_finish (content);
+    cairo_surface_destroy (content);
+    XFreePixmap (display_info->dpy, pixmap);
+
+    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
     {
-        app_content = default_icon_at_size (screen_info->gscr, width, height);
+        cairo_surface_destroy (surface);
+        return NULL;
     }
 
-    app_icon_width = (guint) gdk_pixbuf_get_width (app_content);
-    app_icon_height = (guint) gdk_pixbuf_get_height (app_content);
+    return surface;
+#else /* HAVE_COMPOSITOR */
+    return NULL;
+#endif /* HAVE_COMPOSITOR */
+}
 
-    gdk_pixbuf_copy_area (app_content, 0, 0, app_icon_width, app_icon_height, icon_pixbuf,
-                          (width - app_icon_width) / 2, (height - app_icon_height) / 2);
-    g_object_unref (app_content);
+static void
+free_icon_cache_entry (gpointer data)
+{
+    IconCacheEntry *entry;
 
-    small_icon_size = MIN (width / 4, height / 4);
-    small_icon_size = MIN (small_icon_size, 48);
+    entry = (IconCacheEntry *) data;
+    g_object_unref (entry->pixbuf);
+    g_free (entry);
+}
+
+/*
+ * Same as getAppIcon() but keeps the decoded icon of each size around
+ * until clearAppIconCache() is called, i.e. until the icon changes.
+ */
+GdkPixbuf *
+getCachedAppIcon (Client *c, guint width, guint height)
+{
+    IconCacheEntry *entry;
+    GSList *list, *last;
+    GdkPixbuf *icon;
 
-    small_icon = getAppIcon (screen_info, c->window, small_icon_size, small_icon_size);
+    g_return_val_if_fail (c != NULL, NULL);
 
-    gdk_pixbuf_composite (small_icon, icon_pixbuf,
-                          (width - small_icon_size) / 2, height - small_icon_size,
-                          small_icon_size, small_icon_size,
-                          (width - small_icon_size) / 2, height - small_icon_size,
-                          1.0, 1.0,
-                          GDK_INTERP_BILINEAR,
-                          0xff);
+    for (list = c->app_icons; list; list = g_slist_next (list))
+    {
+        entry = (IconCacheEntry *) list->data;
+        if ((entry->width == width) && (entry->height == height))
+        {
+            return g_object_ref (entry->pixbuf);
+        }
+    }
 
-    g_object_unref (small_icon);
+    icon = getAppIcon (c->screen_info, c->window, width, height);
+    if (!icon)
+    {
+        return NULL;
+    }
 
-    if (FLAG_TEST (c->flags, CLIENT_FLAG_ICONIFIED))
+    if (g_slist_length (c->app_icons) >= ICON_CACHE_SIZE)
     {
-        icon_pixbuf_stated = gdk_pixbuf_copy (icon_pixbuf);
-        gdk_pixbuf_saturate_and_pixelate (icon_pixbuf, icon_pixbuf_stated, 0.55, TRUE);
-        g_object_unref (icon_pixbuf);
-        icon_pixbuf = icon_pixbuf_stated;
+        last = g_slist_last (c->app_icons);
+        free_icon_cache_entry (last->data);
+        c->app_icons = g_slist_delete_link (c->app_icons, last);
     }
+    entry = g_new0 (IconCacheEntry, 1);
+    entry->width = width;
+    entry->height = height;
+    entry->pixbuf = g_object_ref (icon);
+    c->app_icons = g_slist_prepend (c->app_icons, entry);
+
+    return icon;
+}
+
+void
+clearAppIconCache (Client *c)
+{
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
-    return icon_pixbuf;
+    g_slist_free_full (c->app_icons, free_icon_cache_entry);
+    c->app_icons = NULL;
 }
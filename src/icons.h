@@ -31,6 +31,7 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include <cairo/cairo.h>
 
 #include "screen.h"
 #include "client.h"
@@ -39,7 +40,11 @@ GdkPixbuf               *getAppIcon                             (ScreenInfo *,
                                                                  Window,
                                                                  guint,
                                                                  guint);
-GdkPixbuf               *getClientIcon                          (Client *,
+GdkPixbuf               *getCachedAppIcon                       (Client *,
+                                                                 guint,
+                                                                 guint);
+void                     clearAppIconCache                      (Client *);
+cairo_surface_t         *getClientPreview                       (Client *,
                                                                  guint,
                                                                  guint);
 
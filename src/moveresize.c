@@ -67,6 +67,26 @@
 #define use_xor_move(screen_info) (screen_info->params->box_move && !compositorIsActive (screen_info))
 #define use_xor_resize(screen_info) (screen_info->params->box_resize && !compositorIsActive (screen_info))
 
+/* Longest a move configure waits for the compositor to paint the previous one */
+#ifndef MOVE_FRAME_INTERVAL
+#define MOVE_FRAME_INTERVAL 8 /* msec */
+#endif
+
+typedef struct _SnapEdge SnapEdge;
+struct _SnapEdge
+{
+    int pos;   /* position of the edge on its axis */
+    int start; /* extent of the edge on the other axis */
+    int end;
+};
+
+typedef struct _SnapEdges SnapEdges;
+struct _SnapEdges
+{
+    GArray *edges[SIDE_COUNT]; /* sorted by position */
+    guint workspace;
+};
+
 typedef struct _MoveResizeData MoveResizeData;
 struct _MoveResizeData
 {
@@ -91,6 +111,14 @@ struct _MoveResizeData
     gint oldw, oldh;
     gint handle;
     Poswin *poswin;
+    SnapEdges snap_edges;
+    /* Configure pacing */
+    guint flush_timeout_id;
+    gboolean configure_pending;
+    /* Statistics */
+    guint motion_events;
+    guint motion_compressed;
+    guint positions_dropped;
 };
 
 static int
@@ -369,21 +397,41 @@ clientCheckOverlap (int s1, int e1, int s2, int e2)
     return FALSE;
 }
 
-static int
-clientFindClosestEdgeX (Client *c, int edge_pos)
+static gint
+snap_edge_compare (gconstpointer a, gconstpointer b)
 {
-    /* Find the closest edge of anything that we can snap to, taking
-       frames into account, or just return the original value if nothing
-       is within the snapping range. -Cliff */
+    const SnapEdge *e1 = (const SnapEdge *) a;
+    const SnapEdge *e2 = (const SnapEdge *) b;
 
-    Client *c2;
+    return e1->pos - e2->pos;
+}
+
+static void
+clientSnapEdgesAdd (SnapEdges *snap_edges, int side, int pos, int start, int end)
+{
+    SnapEdge edge;
+
+    edge.pos = pos;
+    edge.start = start;
+    edge.end = end;
+    g_array_append_val (snap_edges->edges[side], edge);
+}
+
+static void
+clientSnapEdgesBuild (Client *c, SnapEdges *snap_edges)
+{
     ScreenInfo *screen_info;
+    Client *c2;
     guint i;
-    int snap_width, closest;
+    int side;
+    int x1, y1, x2, y2;
 
     screen_info = c->screen_info;
-    snap_width = screen_info->params->snap_width;
-    closest = edge_pos + snap_width + 2; /* This only needs to be out of the snap range to work. -Cliff */
+    snap_edges->workspace = screen_info->current_ws;
+    for (side = 0; side < SIDE_COUNT; side++)
+    {
+        g_array_set_size (snap_edges->edges[side], 0);
+    }
 
     for (c2 = screen_info->clients, i = 0; i < screen_info->client_count; c2 = c2->next, i++)
     {
@@ -393,63 +441,120 @@ clientFindClosestEdgeX (Client *c, int edge_pos)
                   && FLAG_TEST (c2->flags, CLIENT_FLAG_HAS_STRUT)
                   && FLAG_TEST (c2->xfwm_flags, XFWM_FLAG_VISIBLE))))
         {
+            x1 = frameExtentX (c2);
+            x2 = x1 + frameExtentWidth (c2);
+            y1 = frameExtentY (c2);
+            y2 = y1 + frameExtentHeight (c2);
 
-            if (clientCheckOverlap (c->y - frameExtentTop (c) - 1, c->y + c->height + frameExtentBottom (c) + 1, c2->y - frameExtentTop (c) - 1, c2->y + c2->height + frameExtentBottom (c) + 1))
-            {
-                if (abs (c2->x - frameExtentLeft (c2) - edge_pos) < abs (closest - edge_pos))
-                {
-                    closest = c2->x - frameExtentLeft (c2);
-                }
-                if (abs ((c2->x + c2->width) + frameExtentRight (c2) - edge_pos) < abs (closest - edge_pos))
-                {
-                    closest = (c2->x + c2->width) + frameExtentRight (c2);
-                }
-            }
+            clientSnapEdgesAdd (snap_edges, SIDE_LEFT, x1, y1, y2);
+            clientSnapEdgesAdd (snap_edges, SIDE_RIGHT, x2, y1, y2);
+            clientSnapEdgesAdd (snap_edges, SIDE_TOP, y1, x1, x2);
+            clientSnapEdgesAdd (snap_edges, SIDE_BOTTOM, y2, x1, x2);
         }
     }
 
-    if (abs (closest - edge_pos) > snap_width)
+    for (side = 0; side < SIDE_COUNT; side++)
     {
-        closest = edge_pos;
+        g_array_sort (snap_edges->edges[side], snap_edge_compare);
     }
+    TRACE ("%u edges to snap to", snap_edges->edges[SIDE_LEFT]->len);
+}
 
-    return closest;
+/*
+ * The other windows do not move while we are moving or resizing one,
+ * so collect their edges once, sorted along each axis, and look them up
+ * by dichotomy on pointer motion.
+ */
+static void
+clientSnapEdgesInit (Client *c, SnapEdges *snap_edges)
+{
+    int side;
+
+    for (side = 0; side < SIDE_COUNT; side++)
+    {
+        snap_edges->edges[side] = g_array_new (FALSE, FALSE, sizeof (SnapEdge));
+    }
+    clientSnapEdgesBuild (c, snap_edges);
+}
+
+static void
+clientSnapEdgesClear (SnapEdges *snap_edges)
+{
+    int side;
+
+    for (side = 0; side < SIDE_COUNT; side++)
+    {
+        g_array_free (snap_edges->edges[side], TRUE);
+        snap_edges->edges[side] = NULL;
+    }
+}
+
+static void
+clientSnapEdgesCheck (Client *c, SnapEdges *snap_edges)
+{
+    /* Moving a window across workspaces changes the windows around */
+    if (snap_edges->workspace != c->screen_info->current_ws)
+    {
+        clientSnapEdgesBuild (c, snap_edges);
+    }
+}
+
+/* Index of the first edge at or after pos */
+static guint
+clientSnapEdgesFirst (GArray *edges, int pos)
+{
+    guint lo, hi, mid;
+
+    lo = 0;
+    hi = edges->len;
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if (g_array_index (edges, SnapEdge, mid).pos < pos)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
 }
 
 static int
-clientFindClosestEdgeY (Client *c, int edge_pos)
+clientFindClosestEdge (Client *c, SnapEdges *snap_edges, int edge_pos, int s1, int e1, int side1, int side2)
 {
-    /* This function is mostly identical to the one above, but swaps the
-       axes. If there's a better way to do it than this, I'd like to
-       know. -Cliff */
+    /* Find the closest edge of anything that we can snap to, taking
+       frames into account, or just return the original value if nothing
+       is within the snapping range. -Cliff */
 
-    Client *c2;
-    ScreenInfo *screen_info;
-    guint i;
+    SnapEdge *edge;
+    GArray *edges;
     int snap_width, closest;
+    int side;
+    guint i;
 
-    screen_info = c->screen_info;
-    snap_width = screen_info->params->snap_width;
-    closest = edge_pos + snap_width + 1; /* This only needs to be out of the snap range to work. -Cliff */
+    snap_width = c->screen_info->params->snap_width;
+    closest = edge_pos + snap_width + 2; /* This only needs to be out of the snap range to work. -Cliff */
 
-    for (c2 = screen_info->clients, i = 0; i < screen_info->client_count; c2 = c2->next, i++)
+    clientSnapEdgesCheck (c, snap_edges);
+    for (side = side1; side <= side2; side++)
     {
-        if (FLAG_TEST (c2->xfwm_flags, XFWM_FLAG_VISIBLE)  && (c2 != c) &&
-            (((screen_info->params->snap_to_windows) && (c2->win_layer == c->win_layer))
-             || ((screen_info->params->snap_to_border)
-                  && FLAG_TEST (c2->flags, CLIENT_FLAG_HAS_STRUT)
-                  && FLAG_TEST (c2->xfwm_flags, XFWM_FLAG_VISIBLE))))
+        edges = snap_edges->edges[side];
+        for (i = clientSnapEdgesFirst (edges, edge_pos - snap_width); i < edges->len; i++)
         {
-
-            if (clientCheckOverlap (c->x - frameExtentLeft (c) - 1, c->x + c->width + frameExtentRight (c) + 1, c2->x - frameExtentLeft (c) - 1, c2->x + c2->width + frameExtentRight (c) + 1))
+            edge = &g_array_index (edges, SnapEdge, i);
+            if (edge->pos > edge_pos + snap_width)
             {
-                if (abs (c2->y - frameExtentTop(c2) - edge_pos) < abs (closest - edge_pos))
-                {
-                    closest = c2->y - frameExtentTop (c2);
-                }
-                if (abs ((c2->y + c2->height) + frameExtentBottom (c2) - edge_pos) < abs (closest - edge_pos))
+                break;
+            }
+            if (clientCheckOverlap (s1, e1, edge->start - 1, edge->end + 1))
+            {
+                if (abs (edge->pos - edge_pos) < abs (closest - edge_pos))
                 {
-                    closest = (c2->y + c2->height) + frameExtentBottom (c2);
+                    closest = edge->pos;
                 }
             }
         }
@@ -463,11 +568,30 @@ clientFindClosestEdgeY (Client *c, int edge_pos)
     return closest;
 }
 
+static int
+clientFindClosestEdgeX (Client *c, SnapEdges *snap_edges, int edge_pos)
+{
+    return clientFindClosestEdge (c, snap_edges, edge_pos,
+                                  c->y - frameExtentTop (c) - 1,
+                                  c->y + c->height + frameExtentBottom (c) + 1,
+                                  SIDE_LEFT, SIDE_RIGHT);
+}
+
+static int
+clientFindClosestEdgeY (Client *c, SnapEdges *snap_edges, int edge_pos)
+{
+    return clientFindClosestEdge (c, snap_edges, edge_pos,
+                                  c->x - frameExtentLeft (c) - 1,
+                                  c->x + c->width + frameExtentRight (c) + 1,
+                                  SIDE_TOP, SIDE_BOTTOM);
+}
+
 static void
-clientSnapPosition (Client * c, int prev_x, int prev_y)
+clientSnapPosition (Client * c, SnapEdges *snap_edges, int prev_x, int prev_y)
 {
     ScreenInfo *screen_info;
-    Client *c2;
+    SnapEdge *edge;
+    GArray *edges;
     guint i;
     int cx, cy, delta;
     int disp_x, disp_y, disp_max_x, disp_max_y;
@@ -476,7 +600,6 @@ clientSnapPosition (Client * c, int prev_x, int prev_y)
     int frame_x2, frame_y2;
     int best_frame_x, best_frame_y;
     int best_delta_x, best_delta_y;
-    int c_frame_x1, c_frame_x2, c_frame_y1, c_frame_y2;
     GdkRectangle rect;
 
     g_return_if_fail (c != NULL);
@@ -545,62 +668,95 @@ clientSnapPosition (Client * c, int prev_x, int prev_y)
         }
     }
 
-    for (c2 = screen_info->clients, i = 0; i < screen_info->client_count; c2 = c2->next, i++)
+    clientSnapEdgesCheck (c, snap_edges);
+
+    /* Right edges of other windows against our left edge */
+    edges = snap_edges->edges[SIDE_RIGHT];
+    for (i = clientSnapEdgesFirst (edges, frame_x - best_delta_x); i < edges->len; i++)
     {
-        if (FLAG_TEST (c2->xfwm_flags, XFWM_FLAG_VISIBLE)  && (c2 != c) &&
-            (((screen_info->params->snap_to_windows) && (c2->win_layer == c->win_layer))
-             || ((screen_info->params->snap_to_border)
-                  && FLAG_TEST (c2->flags, CLIENT_FLAG_HAS_STRUT)
-                  && FLAG_TEST (c2->xfwm_flags, XFWM_FLAG_VISIBLE))))
+        edge = &g_array_index (edges, SnapEdge, i);
+        if (edge->pos >= frame_x + best_delta_x)
         {
-            c_frame_x1 = frameExtentX (c2);
-            c_frame_x2 = c_frame_x1 + frameExtentWidth (c2);
-            c_frame_y1 = frameExtentY (c2);
-            c_frame_y2 = c_frame_y1 + frameExtentHeight (c2);
-
-            if ((c_frame_y1 <= frame_y2) && (c_frame_y2 >= frame_y))
+            break;
+        }
+        if ((edge->start <= frame_y2) && (edge->end >= frame_y))
+        {
+            delta = abs (edge->pos - frame_x);
+            if (delta < best_delta_x)
             {
-                delta = abs (c_frame_x2 - frame_x);
-                if (delta < best_delta_x)
+                if (!screen_info->params->snap_resist || ((frame_x <= edge->pos) && (c->x < prev_x)))
                 {
-                    if (!screen_info->params->snap_resist || ((frame_x <= c_frame_x2) && (c->x < prev_x)))
-                    {
-                        best_delta_x = delta;
-                        best_frame_x = c_frame_x2;
-                    }
+                    best_delta_x = delta;
+                    best_frame_x = edge->pos;
                 }
+            }
+        }
+    }
 
-                delta = abs (c_frame_x1 - frame_x2);
-                if (delta < best_delta_x)
+    /* Left edges of other windows against our right edge */
+    edges = snap_edges->edges[SIDE_LEFT];
+    for (i = clientSnapEdgesFirst (edges, frame_x2 - best_delta_x); i < edges->len; i++)
+    {
+        edge = &g_array_index (edges, SnapEdge, i);
+        if (edge->pos >= frame_x2 + best_delta_x)
+        {
+            break;
+        }
+        if ((edge->start <= frame_y2) && (edge->end >= frame_y))
+        {
+            delta = abs (edge->pos - frame_x2);
+            if (delta < best_delta_x)
+            {
+                if (!screen_info->params->snap_resist || ((frame_x2 >= edge->pos) && (c->x > prev_x)))
                 {
-                    if (!screen_info->params->snap_resist || ((frame_x2 >= c_frame_x1) && (c->x > prev_x)))
-                    {
-                        best_delta_x = delta;
-                        best_frame_x = c_frame_x1 - frame_width;
-                    }
+                    best_delta_x = delta;
+                    best_frame_x = edge->pos - frame_width;
                 }
             }
+        }
+    }
 
-            if ((c_frame_x1 <= frame_x2) && (c_frame_x2 >= frame_x))
+    /* Bottom edges of other windows against our top edge */
+    edges = snap_edges->edges[SIDE_BOTTOM];
+    for (i = clientSnapEdgesFirst (edges, frame_y - best_delta_y); i < edges->len; i++)
+    {
+        edge = &g_array_index (edges, SnapEdge, i);
+        if (edge->pos >= frame_y + best_delta_y)
+        {
+            break;
+        }
+        if ((edge->start <= frame_x2) && (edge->end >= frame_x))
+        {
+            delta = abs (edge->pos - frame_y);
+            if (delta < best_delta_y)
             {
-                delta = abs (c_frame_y2 - frame_y);
-                if (delta < best_delta_y)
+                if (!screen_info->params->snap_resist || ((frame_y <= edge->pos) && (c->y < prev_y)))
                 {
-                    if (!screen_info->params->snap_resist || ((frame_y <= c_frame_y2) && (c->y < prev_y)))
-                    {
-                        best_delta_y = delta;
-                        best_frame_y = c_frame_y2;
-                    }
+                    best_delta_y = delta;
+                    best_frame_y = edge->pos;
                 }
+            }
+        }
+    }
 
-                delta = abs (c_frame_y1 - frame_y2);
-                if (delta < best_delta_y)
+    /* Top edges of other windows against our bottom edge */
+    edges = snap_edges->edges[SIDE_TOP];
+    for (i = clientSnapEdgesFirst (edges, frame_y2 - best_delta_y); i < edges->len; i++)
+    {
+        edge = &g_array_index (edges, SnapEdge, i);
+        if (edge->pos >= frame_y2 + best_delta_y)
+        {
+            break;
+        }
+        if ((edge->start <= frame_x2) && (edge->end >= frame_x))
+        {
+            delta = abs (edge->pos - frame_y2);
+            if (delta < best_delta_y)
+            {
+                if (!screen_info->params->snap_resist || ((frame_y2 >= edge->pos) && (c->y > prev_y)))
                 {
-                    if (!screen_info->params->snap_resist || ((frame_y2 >= c_frame_y1) && (c->y > prev_y)))
-                    {
-                        best_delta_y = delta;
-                        best_frame_y = c_frame_y1 - frame_height;
-                    }
+                    best_delta_y = delta;
+                    best_frame_y = edge->pos - frame_height;
                 }
             }
         }
@@ -865,6 +1021,96 @@ clientMoveTile (Client *c, XfwmEventMotion *event)
     return FALSE;
 }
 
+static void
+clientMoveApply (MoveResizeData *passdata)
+{
+    Client *c;
+    XWindowChanges wc;
+    int changes;
+
+    c = passdata->c;
+    changes = CWX | CWY;
+
+    if (passdata->flush_timeout_id)
+    {
+        g_source_remove (passdata->flush_timeout_id);
+        passdata->flush_timeout_id = 0;
+    }
+    passdata->configure_pending = FALSE;
+
+    if (passdata->move_resized)
+    {
+        wc.width = c->width;
+        wc.height = c->height;
+        changes |= CWWidth | CWHeight;
+        passdata->move_resized = FALSE;
+    }
+
+    wc.x = c->x;
+    wc.y = c->y;
+    clientConfigure (c, &wc, changes, passdata->configure_flags);
+    /* Configure applied, clear the flags */
+    passdata->configure_flags = NO_CFG_FLAG;
+}
+
+static gboolean
+clientMoveFlushTimeout (gpointer data)
+{
+    MoveResizeData *passdata = (MoveResizeData *) data;
+
+    TRACE ("entering");
+
+    passdata->flush_timeout_id = 0;
+    if (passdata->configure_pending)
+    {
+        clientMoveApply (passdata);
+    }
+
+    return FALSE;
+}
+
+static void
+clientMoveDefer (MoveResizeData *passdata)
+{
+    if (passdata->configure_pending)
+    {
+        /* The previous position never reached the server */
+        passdata->positions_dropped++;
+    }
+    passdata->configure_pending = TRUE;
+
+    if (passdata->flush_timeout_id == 0)
+    {
+        passdata->flush_timeout_id =
+            g_timeout_add (MOVE_FRAME_INTERVAL, clientMoveFlushTimeout, passdata);
+    }
+}
+
+static void
+clientMoveResizeStatsInit (MoveResizeData *passdata)
+{
+    passdata->flush_timeout_id = 0;
+    passdata->configure_pending = FALSE;
+    passdata->motion_events = 0;
+    passdata->motion_compressed = 0;
+    passdata->positions_dropped = 0;
+}
+
+static void
+clientMoveResizeStatsDone (MoveResizeData *passdata)
+{
+    if (passdata->flush_timeout_id)
+    {
+        g_source_remove (passdata->flush_timeout_id);
+        passdata->flush_timeout_id = 0;
+    }
+    passdata->configure_pending = FALSE;
+
+    DBG ("client \"%s\" (0x%lx): %u motion events, %u compressed, %u positions dropped",
+         passdata->c->name, passdata->c->window, passdata->motion_events,
+         passdata->motion_compressed, passdata->positions_dropped);
+}
+
 static eventFilterStatus
 clientMoveEventFilter (XfwmEvent *event, gpointer data)
 {
@@ -874,7 +1120,6 @@ clientMoveEventFilter (XfwmEvent *event, gpointer data)
     MoveResizeData *passdata = (MoveResizeData *) data;
     Client *c = NULL;
     gboolean moving;
-    XWindowChanges wc;
     int prev_x, prev_y;
     unsigned long cancel_maximize_flags;
     unsigned long cancel_restore_size_flags;
@@ -1002,11 +1247,13 @@ clientMoveEventFilter (XfwmEvent *event, gpointer data)
     }
     else if (event->meta.type == XFWM_EVENT_MOTION)
     {
+        passdata->motion_events++;
         while (xfwm_device_check_mask_event (display_info->devices, display_info->dpy,
                                              PointerMotionMask | ButtonMotionMask, event))
         {
             /* Update the display time */
             myDisplayUpdateCurrentTime (display_info, event);
+            passdata->motion_compressed++;
         }
 
         if (!passdata->grab && use_xor_move(screen_info))
@@ -1053,7 +1300,7 @@ clientMoveEventFilter (XfwmEvent *event, gpointer data)
         c->x = passdata->ox + (event->motion.x_root - passdata->mx);
         c->y = passdata->oy + (event->motion.y_root - passdata->my);
 
-        clientSnapPosition (c, prev_x, prev_y);
+        clientSnapPosition (c, &passdata->snap_edges, prev_x, prev_y);
         if (clientMoveTile (c, &event->motion))
         {
             passdata->configure_flags = CFG_FORCE_REDRAW;
@@ -1081,23 +1328,14 @@ clientMoveEventFilter (XfwmEvent *event, gpointer data)
                 clientDrawOutline (c);
             }
         }
+        else if (compositorIsFramePending (screen_info))
+        {
+            /* Wait for the compositor to catch up with the previous position */
+            clientMoveDefer (passdata);
+        }
         else
         {
-            int changes = CWX | CWY;
-
-            if (passdata->move_resized)
-            {
-                wc.width = c->width;
-                wc.height = c->height;
-                changes |= CWWidth | CWHeight;
-                passdata->move_resized = FALSE;
-            }
-
-            wc.x = c->x;
-            wc.y = c->y;
-            clientConfigure (c, &wc, changes, passdata->configure_flags);
-            /* Configure applied, clear the flags */
-            passdata->configure_flags = NO_CFG_FLAG;
+            clientMoveApply (passdata);
         }
     }
     else if ((event->meta.x->type == UnmapNotify) && (event->meta.window == c->window))
@@ -1177,6 +1415,7 @@ clientMove (Client * c, XfwmEventButton *event)
     passdata.is_transient = clientIsValidTransientOrModal (c);
     passdata.move_resized = FALSE;
     passdata.wireframe = NULL;
+    clientMoveResizeStatsInit (&passdata);
 
     clientSaveSizePos (c);
 
@@ -1239,12 +1478,15 @@ clientMove (Client * c, XfwmEventButton *event)
     /* Clear any previously saved pos flag from screen resize */
     FLAG_UNSET (c->xfwm_flags, XFWM_FLAG_SAVED_POS);
 
+    clientSnapEdgesInit (c, &passdata.snap_edges);
+
     FLAG_SET (c->xfwm_flags, XFWM_FLAG_MOVING_RESIZING);
     TRACE ("entering move loop");
     eventFilterPush (display_info->xfilter, clientMoveEventFilter, &passdata);
     gtk_main ();
     eventFilterPop (display_info->xfilter);
     TRACE ("leaving move loop");
+    clientMoveResizeStatsDone (&passdata);
     if (passdata.client_gone)
     {
         goto move_cleanup;
@@ -1289,6 +1531,8 @@ move_cleanup:
     /* Put back the sidewalks as they ought to be */
     placeSidewalks (screen_info, screen_info->params->wrap_workspaces);
 
+    clientSnapEdgesClear (&passdata.snap_edges);
+
 #ifdef SHOW_POSITION
     if (passdata.poswin)
     {
@@ -1339,33 +1583,44 @@ clientChangeHandle (MoveResizeData *passdata, XfwmEvent *event, int handle)
 }
 
 static void
-clientResizeConfigure (Client *c, int pw, int ph)
+clientResizeConfigure (MoveResizeData *passdata, int pw, int ph)
 {
     ScreenInfo *screen_info;
     DisplayInfo *display_info;
+    Client *c;
 
+    c = passdata->c;
     screen_info = c->screen_info;
     display_info = screen_info->display_info;
 
-    if (pw == c->width && ph == c->height)
+    if (pw == c->width && ph == c->height && !passdata->configure_pending)
     {
         /* Not a resize */
         return;
     }
 #ifdef HAVE_XSYNC
-    if (!FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_WAITING))
+    if (!clientXSyncReady (c))
     {
-        if ((display_info->have_xsync) &&
-            (FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_ENABLED)) &&
-            (c->xsync_counter))
+        /*
+         * The client has not drawn the previous size yet, keep the new
+         * one for when it acknowledges the counter.
+         */
+        if (passdata->configure_pending)
         {
-            clientXSyncRequest (c);
+            passdata->positions_dropped++;
         }
-#endif /* HAVE_XSYNC */
-        clientReconfigure (c, NO_CFG_FLAG);
-#ifdef HAVE_XSYNC
+        passdata->configure_pending = TRUE;
+        return;
+    }
+    if ((display_info->have_xsync) &&
+        (FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_ENABLED)) &&
+        (c->xsync_counter))
+    {
+        clientXSyncRequest (c);
     }
 #endif /* HAVE_XSYNC */
+    passdata->configure_pending = FALSE;
+    clientReconfigure (c, NO_CFG_FLAG);
 }
 
 static eventFilterStatus
@@ -1526,7 +1781,7 @@ clientResizeEventFilter (XfwmEvent *event, gpointer data)
             }
             else
             {
-                clientResizeConfigure (c, prev_width, prev_height);
+                clientResizeConfigure (passdata, prev_width, prev_height);
             }
         }
         else if (passdata->use_keys)
@@ -1536,11 +1791,13 @@ clientResizeEventFilter (XfwmEvent *event, gpointer data)
     }
     else if (event->meta.type == XFWM_EVENT_MOTION)
     {
+        passdata->motion_events++;
         while (xfwm_device_check_mask_event (display_info->devices, display_info->dpy,
                                              ButtonMotionMask | PointerMotionMask, event))
         {
             /* Update the display time */
             myDisplayUpdateCurrentTime (display_info, event);
+            passdata->motion_compressed++;
         }
 
         if (event->meta.x->type == ButtonRelease)
@@ -1568,7 +1825,7 @@ clientResizeEventFilter (XfwmEvent *event, gpointer data)
             c->x = c->x - (c->width - passdata->oldw);
 
             /* Snap the left edge to something. -Cliff */
-            c->x = clientFindClosestEdgeX (c, c->x - frameExtentLeft (c)) + frameExtentLeft (c);
+            c->x = clientFindClosestEdgeX (c, &passdata->snap_edges, c->x - frameExtentLeft (c)) + frameExtentLeft (c);
             c->width = right_edge - c->x;
         }
         else if (move_right)
@@ -1576,7 +1833,7 @@ clientResizeEventFilter (XfwmEvent *event, gpointer data)
             c->width = passdata->ow + (event->motion.x_root - passdata->mx);
 
             /* Attempt to snap the right edge to something. -Cliff */
-            c->width = clientFindClosestEdgeX (c, c->x + c->width + frameExtentRight (c)) - c->x - frameExtentRight (c);
+            c->width = clientFindClosestEdgeX (c, &passdata->snap_edges, c->x + c->width + frameExtentRight (c)) - c->x - frameExtentRight (c);
 
         }
         if (!FLAG_TEST (c->flags, CLIENT_FLAG_SHADED))
@@ -1587,7 +1844,7 @@ clientResizeEventFilter (XfwmEvent *event, gpointer data)
                 c->y = c->y - (c->height - passdata->oldh);
 
                 /* Snap the top edge to something. -Cliff */
-                c->y = clientFindClosestEdgeY (c, c->y - frameExtentTop (c)) + frameExtentTop (c);
+                c->y = clientFindClosestEdgeY (c, &passdata->snap_edges, c->y - frameExtentTop (c)) + frameExtentTop (c);
                 c->height = bottom_edge - c->y;
             }
             else if (move_bottom)
@@ -1595,7 +1852,7 @@ clientResizeEventFilter (XfwmEvent *event, gpointer data)
                 c->height = passdata->oh + (event->motion.y_root - passdata->my);
 
                 /* Attempt to snap the bottom edge to something. -Cliff */
-                c->height = clientFindClosestEdgeY (c, c->y + c->height + frameExtentBottom (c)) - c->y - frameExtentBottom (c);
+                c->height = clientFindClosestEdgeY (c, &passdata->snap_edges, c->y + c->height + frameExtentBottom (c)) - c->y - frameExtentBottom (c);
             }
         }
 
@@ -1638,7 +1895,7 @@ clientResizeEventFilter (XfwmEvent *event, gpointer data)
         }
         else
         {
-            clientResizeConfigure (c, prev_width, prev_height);
+            clientResizeConfigure (passdata, prev_width, prev_height);
         }
     }
     else if (event->meta.type == XFWM_EVENT_BUTTON && !event->button.pressed)
@@ -1662,6 +1919,20 @@ clientResizeEventFilter (XfwmEvent *event, gpointer data)
     {
         /* Ignore enter events */
     }
+#ifdef HAVE_XSYNC
+    else if ((display_info->have_xsync) &&
+             (event->meta.x->type == (display_info->xsync_event_base + XSyncAlarmNotify)) &&
+             (((XSyncAlarmNotifyEvent *) event->meta.x)->alarm == c->xsync_alarm))
+    {
+        /* The client caught up, send the latest size it missed */
+        clientXSyncUpdateValue (c, ((XSyncAlarmNotifyEvent *) event->meta.x)->counter_value);
+        if (passdata->configure_pending && !screen_info->params->box_resize &&
+            clientXSyncReady (c))
+        {
+            clientResizeConfigure (passdata, c->width, c->height);
+        }
+    }
+#endif /* HAVE_XSYNC */
     else
     {
         status = EVENT_FILTER_CONTINUE;
@@ -1728,6 +1999,7 @@ clientResize (Client * c, int handle, XfwmEventButton *event)
     passdata.button = AnyButton;
     passdata.handle = handle;
     passdata.wireframe = NULL;
+    clientMoveResizeStatsInit (&passdata);
     w_orig = c->width;
     h_orig = c->height;
 
@@ -1793,12 +2065,15 @@ clientResize (Client * c, int handle, XfwmEventButton *event)
     /* Clear any previously saved pos flag from screen resize */
     FLAG_UNSET (c->xfwm_flags, XFWM_FLAG_SAVED_POS);
 
+    clientSnapEdgesInit (c, &passdata.snap_edges);
+
     FLAG_SET (c->xfwm_flags, XFWM_FLAG_MOVING_RESIZING);
     TRACE ("entering resize loop");
     eventFilterPush (display_info->xfilter, clientResizeEventFilter, &passdata);
     gtk_main ();
     eventFilterPop (display_info->xfilter);
     TRACE ("leaving resize loop");
+    clientMoveResizeStatsDone (&passdata);
     if (passdata.client_gone)
     {
         goto resize_cleanup;
@@ -1838,6 +2113,7 @@ clientResize (Client * c, int handle, XfwmEventButton *event)
     }
 
 resize_cleanup:
+    clientSnapEdgesClear (&passdata.snap_edges);
     if (passdata.poswin)
     {
         poswinDestroy (passdata.poswin);
@@ -48,6 +48,7 @@
 #include <stdio.h>
 
 #include "mypixmap.h"
+#include "themecache.h"
 #include "xpm-color-table.h"
 
 enum buf_op
@@ -64,12 +65,15 @@ typedef struct
     guint16 green;
     guint16 blue;
     gint transparent;
+    /* RGBA bytes as laid out in the pixbuf */
+    guchar pixel[4];
 }
 XPMColor;
 
 struct file_handle
 {
-    FILE *infile;
+    const gchar *pos;
+    const gchar *end;
     gchar *buffer;
     guint buffer_size;
 };
@@ -200,19 +204,26 @@ parse_color (const char *spec, XPMColor   *colorPtr)
 }
 
 static gint
-xpm_seek_string (FILE *infile, const gchar *str)
+xpm_seek_string (struct file_handle *h, const gchar *str)
 {
-    char instr[1024];
+    const gchar *start;
+    gsize len;
 
-    while (!feof (infile))
+    len = strlen (str);
+    while (h->pos < h->end)
     {
-        if (fscanf (infile, "%1023s", instr) < 0)
+        while (h->pos < h->end && g_ascii_isspace (*h->pos))
         {
-                return FALSE;
+            h->pos++;
+        }
+        start = h->pos;
+        while (h->pos < h->end && !g_ascii_isspace (*h->pos))
+        {
+            h->pos++;
         }
-        if (strcmp (instr, str) == 0)
+        if ((gsize) (h->pos - start) == len && memcmp (start, str, len) == 0)
         {
-                return TRUE;
+            return TRUE;
         }
     }
 
@@ -220,32 +231,28 @@ xpm_seek_string (FILE *infile, const gchar *str)
 }
 
 static gint
-xpm_seek_char (FILE *infile, gchar c)
+xpm_seek_char (struct file_handle *h, gchar c)
 {
-    gint b, oldb;
+    gchar b;
 
-    while ((b = getc (infile)) != EOF)
+    while (h->pos < h->end)
     {
+        b = *h->pos++;
         if (c != b && b == '/')
         {
-            b = getc (infile);
-            if (b == EOF)
+            if (h->pos >= h->end)
             {
                 return FALSE;
             }
-            else if (b == '*')
+            if (*h->pos == '*')
             {   /* we have a comment */
-                 b = -1;
-                 do
-                 {
-                     oldb = b;
-                     b = getc (infile);
-                     if (b == EOF)
-                     {
-                             return FALSE;
-                     }
-                 }
-                 while (!(oldb == '*' && b == '/'));
+                h->pos = g_strstr_len (h->pos + 1, h->end - h->pos - 1, "*/");
+                if (!h->pos)
+                {
+                    h->pos = h->end;
+                    return FALSE;
+                }
+                h->pos += 2;
             }
         }
         else if (c == b)
@@ -258,67 +265,36 @@ xpm_seek_char (FILE *infile, gchar c)
 }
 
 static gint
-xpm_read_string (FILE *infile, gchar **buffer, guint *buffer_size)
+xpm_read_string (struct file_handle *h)
 {
-    gint c;
-    guint cnt = 0, bufsiz, ret;
-    gchar *buf;
-
-    buf = *buffer;
-    bufsiz = *buffer_size;
-    ret = FALSE;
+    const gchar *start, *stop;
+    guint len;
 
-    if (buf == NULL)
+    start = memchr (h->pos, '"', h->end - h->pos);
+    if (!start)
     {
-        bufsiz = 10 * sizeof (gchar);
-        buf = g_new (gchar, bufsiz);
+        h->pos = h->end;
+        return FALSE;
     }
-
-    do
+    start++;
+    stop = memchr (start, '"', h->end - start);
+    if (!stop)
     {
-        c = getc (infile);
+        h->pos = h->end;
+        return FALSE;
     }
-    while (c != EOF && c != '"');
+    h->pos = stop + 1;
 
-    if (c != '"')
+    len = stop - start;
+    if (len >= h->buffer_size)
     {
-        goto out;
-    }
-    while ((c = getc (infile)) != EOF)
-    {
-        if (cnt == bufsiz)
-        {
-            guint new_size = bufsiz * 2;
-
-            if (new_size > bufsiz)
-            {
-                bufsiz = new_size;
-            }
-            else
-            {
-                goto out;
-            }
-            buf = g_realloc (buf, bufsiz);
-            buf[bufsiz - 1] = '\0';
-        }
-
-        if (c != '"')
-        {
-            buf[cnt++] = c;
-        }
-        else
-        {
-            buf[cnt] = 0;
-            ret = TRUE;
-            break;
-        }
+        h->buffer_size = MAX (len + 1, 2 * h->buffer_size);
+        h->buffer = g_realloc (h->buffer, h->buffer_size);
     }
+    memcpy (h->buffer, start, len);
+    h->buffer[len] = '\0';
 
-out:
-    buf[bufsiz - 1] = '\0';     /* ensure null termination for errors */
-    *buffer = buf;
-    *buffer_size = bufsiz;
-    return ret;
+    return TRUE;
 }
 
 static const gchar *
@@ -483,11 +459,11 @@ file_buffer (enum buf_op op, gpointer handle)
     switch (op)
     {
         case op_header:
-            if (xpm_seek_string (h->infile, "XPM") != TRUE)
+            if (xpm_seek_string (h, "XPM") != TRUE)
             {
                 break;
             }
-            if (xpm_seek_char (h->infile, '{') != TRUE)
+            if (xpm_seek_char (h, '{') != TRUE)
             {
                 break;
             }
@@ -495,13 +471,15 @@ file_buffer (enum buf_op op, gpointer handle)
             FALLTHROUGH;
 
         case op_cmap:
-            xpm_seek_char (h->infile, '"');
-            fseek (h->infile, -1, SEEK_CUR);
+            if (xpm_seek_char (h, '"'))
+            {
+                h->pos--;
+            }
             /* Fall through to the xpm_read_string. */
             FALLTHROUGH;
 
         case op_body:
-            if(!xpm_read_string (h->infile, &h->buffer, &h->buffer_size))
+            if(!xpm_read_string (h))
             {
                 return NULL;
             }
@@ -525,6 +503,8 @@ pixbuf_create_from_xpm (gpointer handle, xfwmColorSymbol *color_sym)
     gint cnt, xcnt, ycnt, wbytes, n;
     GHashTable *color_hash;
     XPMColor *colors, *color, *fallbackcolor;
+    guint16 *code_map;
+    guint code;
     guchar *pixtmp;
     GdkPixbuf *pixbuf;
 
@@ -556,12 +536,22 @@ pixbuf_create_from_xpm (gpointer handle, xfwmColorSymbol *color_sym)
         return NULL;
     }
 
-    /* The hash is used for fast lookups of color from chars */
+    /*
+     * Codes of up to 2 chars (i.e. all the themes we know of) are looked
+     * up directly in a table indexed by the code, longer ones go through
+     * the hash. Unknown codes map to the first color either way.
+     */
+    code_map = NULL;
+    if (cpp <= 2)
+    {
+        code_map = g_new0 (guint16, 1 << (8 * cpp));
+    }
     color_hash = g_hash_table_new (g_str_hash, g_str_equal);
 
     name_buf = g_try_malloc (n_col * (cpp + 1));
     if (!name_buf) {
         g_hash_table_destroy (color_hash);
+        g_free (code_map);
         g_warning ("Cannot allocate buffer");
         return NULL;
     }
@@ -570,6 +560,7 @@ pixbuf_create_from_xpm (gpointer handle, xfwmColorSymbol *color_sym)
     if (!colors)
     {
         g_hash_table_destroy (color_hash);
+        g_free (code_map);
         g_free (name_buf);
         g_warning ("Cannot allocate colors for Pixmap");
         return NULL;
@@ -583,6 +574,7 @@ pixbuf_create_from_xpm (gpointer handle, xfwmColorSymbol *color_sym)
         if (!buffer)
         {
             g_hash_table_destroy (color_hash);
+            g_free (code_map);
             g_free (name_buf);
             g_free (colors);
             g_warning ("Cannot load colormap attributes");
@@ -609,7 +601,24 @@ pixbuf_create_from_xpm (gpointer handle, xfwmColorSymbol *color_sym)
         }
 
         g_free (color_name);
-        g_hash_table_insert (color_hash, color->color_string, color);
+        color->pixel[0] = color->red   >> 8;
+        color->pixel[1] = color->green >> 8;
+        color->pixel[2] = color->blue  >> 8;
+        color->pixel[3] = color->transparent ? 0 : 0xFF;
+
+        if (code_map)
+        {
+            code = (guchar) color->color_string[0];
+            if (cpp == 2)
+            {
+                code = (code << 8) | (guchar) color->color_string[1];
+            }
+            code_map[code] = cnt;
+        }
+        else
+        {
+            g_hash_table_insert (color_hash, color->color_string, color);
+        }
 
         if (cnt == 0)
         {
@@ -622,6 +631,7 @@ pixbuf_create_from_xpm (gpointer handle, xfwmColorSymbol *color_sym)
     if (!pixbuf)
     {
         g_hash_table_destroy (color_hash);
+        g_free (code_map);
         g_free (colors);
         g_free (name_buf);
         g_warning ("Cannot allocate Pixbuf");
@@ -640,7 +650,28 @@ pixbuf_create_from_xpm (gpointer handle, xfwmColorSymbol *color_sym)
             continue;
         }
 
-        for (n = 0, cnt = 0, xcnt = 0; n < wbytes; n += cpp, xcnt++)
+        if (cpp == 1)
+        {
+            for (xcnt = 0; xcnt < w; xcnt++, pixtmp += 4)
+            {
+                color = &colors[code_map[(guchar) buffer[xcnt]]];
+                memcpy (pixtmp, color->pixel, 4);
+            }
+            continue;
+        }
+
+        if (cpp == 2)
+        {
+            for (n = 0; n < wbytes; n += 2, pixtmp += 4)
+            {
+                code = ((guchar) buffer[n] << 8) | (guchar) buffer[n + 1];
+                color = &colors[code_map[code]];
+                memcpy (pixtmp, color->pixel, 4);
+            }
+            continue;
+        }
+
+        for (n = 0; n < wbytes; n += cpp, pixtmp += 4)
         {
             strncpy (pixel_str, &buffer[n], cpp);
             pixel_str[cpp] = 0;
@@ -652,23 +683,12 @@ pixbuf_create_from_xpm (gpointer handle, xfwmColorSymbol *color_sym)
             {
                 color = fallbackcolor;
             }
-
-            *pixtmp++ = color->red   >> 8;
-            *pixtmp++ = color->green >> 8;
-            *pixtmp++ = color->blue  >> 8;
-
-            if (color->transparent)
-            {
-                *pixtmp++ = 0;
-            }
-            else
-            {
-                *pixtmp++ = 0xFF;
-            }
+            memcpy (pixtmp, color->pixel, 4);
         }
     }
 
     g_hash_table_destroy (color_hash);
+    g_free (code_map);
     g_free (colors);
     g_free (name_buf);
 
@@ -679,33 +699,32 @@ pixbuf_create_from_xpm (gpointer handle, xfwmColorSymbol *color_sym)
 static GdkPixbuf *
 xpm_image_load (const char *filename, xfwmColorSymbol *color_sym)
 {
-    guchar buffer[1024];
+    GMappedFile *mapped;
     GdkPixbuf *pixbuf;
     struct file_handle h;
-    int size;
-    FILE *f;
+    gsize size;
 
     TRACE ("file %s", filename);
 
-    f = g_fopen (filename, "rb");
-    if (!f)
+    mapped = g_mapped_file_new (filename, FALSE, NULL);
+    if (!mapped)
     {
         return NULL;
     }
 
-    size = fread (&buffer, 1, sizeof (buffer), f);
+    size = g_mapped_file_get_length (mapped);
     if (size == 0)
     {
-        fclose (f);
+        g_mapped_file_unref (mapped);
         return NULL;
     }
 
-    fseek (f, 0, SEEK_SET);
     memset (&h, 0, sizeof (h));
-    h.infile = f;
+    h.pos = g_mapped_file_get_contents (mapped);
+    h.end = h.pos + size;
     pixbuf = pixbuf_create_from_xpm (&h, color_sym);
     g_free (h.buffer);
-    fclose (f);
+    g_mapped_file_unref (mapped);
 
     return pixbuf;
 }
@@ -799,7 +818,7 @@ xfwmPixmapCompose (GdkPixbuf *pixbuf, const gchar * dir, const gchar * file)
 }
 
 static gboolean
-xfwmPixmapDrawFromGdkPixbuf (xfwmPixmap * pm, GdkPixbuf *pixbuf)
+xfwmPixmapDrawFromSurface (xfwmPixmap * pm, cairo_surface_t *image)
 {
     cairo_surface_t *dest_pixmap;
     cairo_surface_t *dest_bitmap;
@@ -807,8 +826,10 @@ xfwmPixmapDrawFromGdkPixbuf (xfwmPixmap * pm, GdkPixbuf *pixbuf)
     gint width, height;
     gint dest_x, dest_y;
     guchar *pixels;
-    gint dpx;
+    guint32 *row;
+    gint stride;
     gboolean status, start_status;
+    gboolean opaque;
     gint x, y, start;
 
     g_return_val_if_fail (pm != NULL, FALSE);
@@ -833,23 +854,26 @@ xfwmPixmapDrawFromGdkPixbuf (xfwmPixmap * pm, GdkPixbuf *pixbuf)
         return FALSE;
     }
 
-    width = MIN (gdk_pixbuf_get_width (pixbuf), pm->width);
-    height = MIN (gdk_pixbuf_get_height (pixbuf), pm->height);
+    width = MIN (cairo_image_surface_get_width (image), pm->width);
+    height = MIN (cairo_image_surface_get_height (image), pm->height);
     dest_x = (pm->width - width) / 2;
     dest_y = (pm->height - height) / 2;
+    /* Whatever the image does not cover is left undefined in the mask */
+    opaque = ((width == pm->width) && (height == pm->height));
 
     cr = cairo_create (dest_pixmap);
-    gdk_cairo_set_source_pixbuf (cr, pixbuf, dest_x, dest_y);
+    cairo_set_source_surface (cr, image, dest_x, dest_y);
     cairo_paint (cr);
     cairo_destroy (cr);
 
     cr = cairo_create (dest_bitmap);
-    if (gdk_pixbuf_get_has_alpha (pixbuf) && width > 0)
+    if (cairo_image_surface_get_format (image) == CAIRO_FORMAT_ARGB32 && width > 0)
     {
         /* draw alpha with threshold as gdk_pixbuf_render_threshold_alpha did before */
 
-        pixels = gdk_pixbuf_get_pixels (pixbuf);
-        dpx = gdk_pixbuf_get_rowstride (pixbuf) / gdk_pixbuf_get_width (pixbuf);
+        cairo_surface_flush (image);
+        pixels = cairo_image_surface_get_data (image);
+        stride = cairo_image_surface_get_stride (image);
 
         cairo_translate (cr, dest_x, dest_y);
         cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
@@ -858,11 +882,16 @@ xfwmPixmapDrawFromGdkPixbuf (xfwmPixmap * pm, GdkPixbuf *pixbuf)
 
         for (y = 0; y < height; y++)
         {
+            row = (guint32 *) (pixels + y * stride);
             start_status = FALSE;
             start = 0;
             for (x = 0; x < width; x++)
             {
-                status = pixels[(y * width + x + 1) * dpx - 1] == 0xff;
+                status = (row[x] >> 24) == 0xff;
+                if (!status)
+                {
+                    opaque = FALSE;
+                }
                 if (status != start_status)
                 {
                     if (!status)
@@ -896,6 +925,8 @@ xfwmPixmapDrawFromGdkPixbuf (xfwmPixmap * pm, GdkPixbuf *pixbuf)
     cairo_surface_destroy (dest_pixmap);
     cairo_surface_destroy (dest_bitmap);
 
+    pm->opaque = opaque;
+
     return TRUE;
 }
 
@@ -948,19 +979,14 @@ xfwmPixmapRenderGdkPixbuf (xfwmPixmap * pm, GdkPixbuf *pixbuf)
     return TRUE;
 }
 
-gboolean
-xfwmPixmapLoad (ScreenInfo * screen_info, xfwmPixmap * pm, const gchar * dir, const gchar * file, xfwmColorSymbol * cs)
+static cairo_surface_t *
+xfwmPixmapLoadImage (const gchar * dir, const gchar * file, xfwmColorSymbol * cs)
 {
+    cairo_surface_t *image;
     gchar *filename;
     gchar *filexpm;
     GdkPixbuf *pixbuf;
 
-    g_return_val_if_fail (pm != NULL, FALSE);
-    g_return_val_if_fail (dir != NULL, FALSE);
-    g_return_val_if_fail (file != NULL, FALSE);
-    TRACE ("pixmap %p, dir %s, file %s", pm, dir, file);
-
-    xfwmPixmapInit (screen_info, pm);
     /*
      * Always try to load the XPM first, using our own routine
      * that supports XPM color symbol susbstitution (used to
@@ -975,6 +1001,33 @@ xfwmPixmapLoad (ScreenInfo * screen_info, xfwmPixmap * pm, const gchar * dir, co
     /* Compose with other image formats, if any available. */
     pixbuf = xfwmPixmapCompose (pixbuf, dir, file);
     if (!pixbuf)
+    {
+        return NULL;
+    }
+    image = gdk_cairo_surface_create_from_pixbuf (pixbuf, 1, NULL);
+    g_object_unref (pixbuf);
+
+    return image;
+}
+
+gboolean
+xfwmPixmapLoad (ScreenInfo * screen_info, xfwmPixmap * pm, ThemeCache * cache,
+                const gchar * dir, const gchar * file, xfwmColorSymbol * cs)
+{
+    cairo_surface_t *image;
+
+    g_return_val_if_fail (pm != NULL, FALSE);
+    g_return_val_if_fail (dir != NULL, FALSE);
+    g_return_val_if_fail (file != NULL, FALSE);
+    TRACE ("pixmap %p, dir %s, file %s", pm, dir, file);
+
+    xfwmPixmapInit (screen_info, pm);
+    if (!themeCacheLookup (cache, file, &image))
+    {
+        image = xfwmPixmapLoadImage (dir, file, cs);
+        themeCacheStore (cache, file, image);
+    }
+    if (!image)
     {
         /*
          * Cannot find a suitable image format for some part,
@@ -984,14 +1037,14 @@ xfwmPixmapLoad (ScreenInfo * screen_info, xfwmPixmap * pm, const gchar * dir, co
         return FALSE;
     }
     xfwmPixmapCreate (screen_info, pm,
-                      gdk_pixbuf_get_width (pixbuf),
-                      gdk_pixbuf_get_height (pixbuf));
-    xfwmPixmapDrawFromGdkPixbuf (pm, pixbuf);
+                      cairo_image_surface_get_width (image),
+                      cairo_image_surface_get_height (image));
+    xfwmPixmapDrawFromSurface (pm, image);
 
 #ifdef HAVE_RENDER
     xfwmPixmapRefreshPict (pm);
 #endif
-    g_object_unref (pixbuf);
+    cairo_surface_destroy (image);
 
     return TRUE;
 }
@@ -1017,6 +1070,7 @@ xfwmPixmapCreate (ScreenInfo * screen_info, xfwmPixmap * pm,
                                   pm->pixmap, width, height, 1);
         pm->width = width;
         pm->height = height;
+        pm->opaque = FALSE;
 #ifdef HAVE_RENDER
         pm->pict_format = XRenderFindVisualFormat (myScreenGetXDisplay (screen_info),
                                                    screen_info->visual);
@@ -1035,6 +1089,7 @@ xfwmPixmapInit (ScreenInfo * screen_info, xfwmPixmap * pm)
     pm->mask = None;
     pm->width = 0;
     pm->height = 0;
+    pm->opaque = FALSE;
 #ifdef HAVE_RENDER
     pm->pict_format = XRenderFindVisualFormat (myScreenGetXDisplay (screen_info),
                                                screen_info->visual);
@@ -1078,36 +1133,49 @@ xfwmPixmapNone (xfwmPixmap * pm)
     return (pm->pixmap == None);
 }
 
+/* Tiling from a missing pixmap fills the mask, so it counts as opaque too */
+gboolean
+xfwmPixmapOpaque (xfwmPixmap * pm)
+{
+    TRACE ("pixmap %p", pm);
+
+    g_return_val_if_fail (pm != NULL, FALSE);
+    return ((pm->pixmap == None) || (pm->opaque));
+}
+
 static void
-xfwmPixmapFillRectangle (Display *dpy, int screen, Pixmap pm, Drawable d,
+xfwmPixmapFillRectangle (ScreenInfo *screen_info, guint depth, Pixmap pm, Drawable d,
                          int x, int y, int width, int height)
 {
+    Display *dpy;
     XGCValues gv;
     GC gc;
-    unsigned long mask;
 
     TRACE ("(%i,%i) [%i×%i]", x, y, width, height);
 
-    if ((width < 1) || (height < 1))
+    if ((width < 1) || (height < 1) || (d == None))
     {
         return;
     }
-    gv.fill_style = FillTiled;
-    gv.tile = pm;
-    gv.ts_x_origin = x;
-    gv.ts_y_origin = y;
-    gv.foreground = WhitePixel (dpy, screen);
-    if (gv.tile != None)
+
+    /* Xlib always sends the tile so the pixmap may be freed, a tiled
+     * fill is thus ChangeGC + PolyFillRectangle; an unchanged
+     * foreground is skipped, leaving a solid fill at one request */
+    dpy = myScreenGetXDisplay (screen_info);
+    if (pm != None)
     {
-        mask = GCTile | GCFillStyle | GCTileStipXOrigin;
+        gv.tile = pm;
+        gv.ts_x_origin = x;
+        gc = myScreenGetPooledGC (screen_info, d, depth, FillTiled);
+        XChangeGC (dpy, gc, GCTile | GCTileStipXOrigin, &gv);
     }
     else
     {
-        mask = GCForeground;
+        gv.foreground = WhitePixel (dpy, screen_info->screen);
+        gc = myScreenGetPooledGC (screen_info, d, depth, FillSolid);
+        XChangeGC (dpy, gc, GCForeground, &gv);
     }
-    gc = XCreateGC (dpy, d, mask, &gv);
     XFillRectangle (dpy, d, gc, x, y, width, height);
-    XFreeGC (dpy, gc);
 }
 
 void
@@ -1121,11 +1189,9 @@ xfwmPixmapFill (xfwmPixmap * src, xfwmPixmap * dst,
         return;
     }
 
-    xfwmPixmapFillRectangle (myScreenGetXDisplay (src->screen_info),
-                             src->screen_info->screen,
+    xfwmPixmapFillRectangle (src->screen_info, src->screen_info->depth,
                              src->pixmap, dst->pixmap, x, y, width, height);
-    xfwmPixmapFillRectangle (myScreenGetXDisplay (src->screen_info),
-                             src->screen_info->screen,
+    xfwmPixmapFillRectangle (src->screen_info, 1,
                              src->mask, dst->mask, x, y, width, height);
 #ifdef HAVE_RENDER
     xfwmPixmapRefreshPict (dst);
@@ -1140,6 +1206,7 @@ xfwmPixmapDuplicate (xfwmPixmap * src, xfwmPixmap * dst)
 
     xfwmPixmapCreate (src->screen_info, dst, src->width, src->height);
     xfwmPixmapFill (src, dst, 0, 0, src->width, src->height);
+    dst->opaque = src->opaque;
 }
 
 cairo_surface_t *
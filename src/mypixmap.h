@@ -54,12 +54,15 @@ struct _xfwmPixmap
     Picture pict;
 #endif
     gint width, height;
+    /* Mask known to have no transparent pixel */
+    gboolean opaque;
 };
 
 gboolean                 xfwmPixmapRenderGdkPixbuf              (xfwmPixmap *,
                                                                  GdkPixbuf *);
 gboolean                 xfwmPixmapLoad                         (ScreenInfo *,
                                                                  xfwmPixmap *,
+                                                                 ThemeCache *,
                                                                  const gchar *,
                                                                  const gchar *,
                                                                  xfwmColorSymbol *);
@@ -71,6 +74,7 @@ void                     xfwmPixmapInit                         (ScreenInfo *,
                                                                  xfwmPixmap *);
 void                     xfwmPixmapFree                         (xfwmPixmap *);
 gboolean                 xfwmPixmapNone                         (xfwmPixmap *);
+gboolean                 xfwmPixmapOpaque                       (xfwmPixmap *);
 void                     xfwmPixmapFill                         (xfwmPixmap *,
                                                                  xfwmPixmap *,
                                                                  gint,
@@ -24,6 +24,8 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
@@ -42,18 +44,60 @@
 #include "hints.h"
 #include "misc.h"
 #include "netwm.h"
+#include "placement.h"
 #include "screen.h"
 #include "stacking.h"
 #include "terminate.h"
 #include "transients.h"
 #include "workspaces.h"
 
-void
-clientSetNetState (Client * c)
+#define NET_PROPS_STATE                 (1<<0)
+#define NET_PROPS_ACTIONS               (1<<1)
+
+static void clientWriteNetActions (Client *);
+static gboolean update_net_props_idle_cb (gpointer);
+
+static void
+clientQueueNetProps (Client * c, guint props)
+{
+    ScreenInfo *screen_info;
+
+    screen_info = c->screen_info;
+    c->net_props_dirty |= props;
+    if (c->net_props_queued)
+    {
+        return;
+    }
+
+    screen_info->net_props_queue = g_list_prepend (screen_info->net_props_queue, c);
+    c->net_props_queued = TRUE;
+    if (screen_info->net_props_queue_id == 0)
+    {
+        screen_info->net_props_queue_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                                                           update_net_props_idle_cb, screen_info, NULL);
+    }
+}
+
+/* Returns TRUE if the atom list differs from the one last written */
+static gboolean
+clientNetAtomsChanged (Atom *written, gint *written_size, Atom *data, gint size)
+{
+    if ((*written_size == size) && (memcmp (written, data, size * sizeof (Atom)) == 0))
+    {
+        return FALSE;
+    }
+    memcpy (written, data, size * sizeof (Atom));
+    *written_size = size;
+
+    return TRUE;
+}
+
+static void
+clientWriteNetState (Client * c)
 {
     ScreenInfo *screen_info;
     DisplayInfo *display_info;
-    Atom data[16];
+    Atom data[NET_ATOMS_SIZE];
     int i;
 
     g_return_if_fail (c != NULL);
@@ -134,9 +178,84 @@ clientSetNetState (Client * c)
         TRACE ("focused");
         data[i++] = display_info->atoms[NET_WM_STATE_FOCUSED];
     }
-    XChangeProperty (display_info->dpy, c->window,
-                     display_info->atoms[NET_WM_STATE], XA_ATOM, 32,
-                     PropModeReplace, (unsigned char *) data, i);
+    if (clientNetAtomsChanged (c->net_wm_state, &c->net_wm_state_size, data, i))
+    {
+        XChangeProperty (display_info->dpy, c->window,
+                         display_info->atoms[NET_WM_STATE], XA_ATOM, 32,
+                         PropModeReplace, (unsigned char *) data, i);
+    }
+}
+
+/*
+ * State and allowed actions flip several times within a single operation,
+ * they are only written once the main loop is idle, and only when changed.
+ */
+void
+clientSetNetState (Client * c)
+{
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    clientQueueNetProps (c, NET_PROPS_STATE);
+}
+
+void
+clientFlushNetProps (Client * c)
+{
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    if (c->net_props_dirty & NET_PROPS_STATE)
+    {
+        clientWriteNetState (c);
+    }
+    if (c->net_props_dirty & NET_PROPS_ACTIONS)
+    {
+        clientWriteNetActions (c);
+    }
+    clientClearNetProps (c);
+}
+
+void
+clientClearNetProps (Client * c)
+{
+    ScreenInfo *screen_info;
+
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    c->net_props_dirty = 0;
+    if (!c->net_props_queued)
+    {
+        return;
+    }
+
+    screen_info = c->screen_info;
+    screen_info->net_props_queue = g_list_remove (screen_info->net_props_queue, c);
+    c->net_props_queued = FALSE;
+    if (!screen_info->net_props_queue && screen_info->net_props_queue_id)
+    {
+        g_source_remove (screen_info->net_props_queue_id);
+        screen_info->net_props_queue_id = 0;
+    }
+}
+
+static gboolean
+update_net_props_idle_cb (gpointer data)
+{
+    ScreenInfo *screen_info;
+    Client *c;
+
+    screen_info = (ScreenInfo *) data;
+    /* Cleared first, so that flushing the last client keeps the source */
+    screen_info->net_props_queue_id = 0;
+    while (screen_info->net_props_queue)
+    {
+        c = (Client *) screen_info->net_props_queue->data;
+        clientFlushNetProps (c);
+    }
+
+    return (FALSE);
 }
 
 void
@@ -925,8 +1044,13 @@ clientGetInitialNetWmDesktop (Client * c)
     }
 }
 
-void
-clientSetNetClientList (ScreenInfo * screen_info, Atom a, GList * list)
+/*
+ * Writes the list of client windows into property "a" on the root window,
+ * given the content last written in "published". Nothing is written when
+ * the list has not changed, and windows added at the end are appended.
+ */
+static void
+clientSetNetClientList (ScreenInfo * screen_info, Atom a, GList * list, GArray * published)
 {
     Window *listw;
     Window *index_dest;
@@ -938,7 +1062,11 @@ clientSetNetClientList (ScreenInfo * screen_info, Atom a, GList * list)
     size = g_list_length (list);
     if (size < 1)
     {
-        XDeleteProperty (myScreenGetXDisplay (screen_info), screen_info->xroot, a);
+        if (published->len > 0)
+        {
+            XDeleteProperty (myScreenGetXDisplay (screen_info), screen_info->xroot, a);
+            g_array_set_size (published, 0);
+        }
         return;
     }
 
@@ -952,12 +1080,77 @@ clientSetNetClientList (ScreenInfo * screen_info, Atom a, GList * list)
             Client *c = (Client *) index_src->data;
             *index_dest = c->window;
         }
-        XChangeProperty (myScreenGetXDisplay (screen_info), screen_info->xroot, a, XA_WINDOW, 32, PropModeReplace,
-            (unsigned char *) listw, size);
+
+        if ((published->len > 0) && ((guint) size >= published->len) &&
+            (memcmp (listw, published->data, published->len * sizeof (Window)) == 0))
+        {
+            if ((guint) size > published->len)
+            {
+                XChangeProperty (myScreenGetXDisplay (screen_info), screen_info->xroot, a, XA_WINDOW, 32, PropModeAppend,
+                    (unsigned char *) (listw + published->len), size - published->len);
+                g_array_append_vals (published, listw + published->len, size - published->len);
+            }
+        }
+        else
+        {
+            XChangeProperty (myScreenGetXDisplay (screen_info), screen_info->xroot, a, XA_WINDOW, 32, PropModeReplace,
+                (unsigned char *) listw, size);
+            g_array_set_size (published, 0);
+            g_array_append_vals (published, listw, size);
+        }
         g_free (listw);
     }
 }
 
+static gboolean
+update_client_list_idle_cb (gpointer data)
+{
+    ScreenInfo *screen_info;
+
+    screen_info = (ScreenInfo *) data;
+    screen_info->net_client_list_id = 0;
+    clientFlushNetClientList (screen_info);
+
+    return (FALSE);
+}
+
+/*
+ * The client lists change several times in a row when windows are mapped,
+ * raised or withdrawn, so they are only written once the main loop is idle.
+ */
+void
+clientQueueNetClientList (ScreenInfo * screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+
+    if (screen_info->net_client_list_id == 0)
+    {
+        screen_info->net_client_list_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                                                           update_client_list_idle_cb, screen_info, NULL);
+    }
+}
+
+void
+clientFlushNetClientList (ScreenInfo * screen_info)
+{
+    DisplayInfo *display_info;
+
+    g_return_if_fail (screen_info != NULL);
+    TRACE ("entering");
+
+    if (screen_info->net_client_list_id)
+    {
+        g_source_remove (screen_info->net_client_list_id);
+        screen_info->net_client_list_id = 0;
+    }
+
+    display_info = screen_info->display_info;
+    clientSetNetClientList (screen_info, display_info->atoms[NET_CLIENT_LIST],
+                            screen_info->windows, screen_info->net_client_list);
+    clientSetNetClientList (screen_info, display_info->atoms[NET_CLIENT_LIST_STACKING],
+                            screen_info->windows_stack, screen_info->net_client_list_stacking);
+}
+
 gboolean
 clientValidateNetStrut (Client * c)
 {
@@ -1100,6 +1293,7 @@ clientGetNetStruts (Client * c)
     {
         clientValidateNetStrut (c);
     }
+    strutsIndexUpdate (c);
 
     /* check for a change in struts flags */
     new_flags = c->flags & (CLIENT_FLAG_HAS_STRUT | CLIENT_FLAG_HAS_STRUT_PARTIAL);
@@ -1123,12 +1317,12 @@ clientGetNetStruts (Client * c)
     return FALSE;
 }
 
-void
-clientSetNetActions (Client * c)
+static void
+clientWriteNetActions (Client * c)
 {
     ScreenInfo *screen_info;
     DisplayInfo *display_info;
-    Atom atoms[16];
+    Atom atoms[NET_ATOMS_SIZE];
     int i;
 
     g_return_if_fail (c != NULL);
@@ -1175,8 +1369,20 @@ clientSetNetActions (Client * c)
         atoms[i++] = display_info->atoms[NET_WM_ACTION_CHANGE_DESKTOP];
         atoms[i++] = display_info->atoms[NET_WM_ACTION_STICK];
     }
-    XChangeProperty (clientGetXDisplay (c), c->window, display_info->atoms[NET_WM_ALLOWED_ACTIONS],
-                     XA_ATOM, 32, PropModeReplace, (unsigned char *) atoms, i);
+    if (clientNetAtomsChanged (c->net_wm_actions, &c->net_wm_actions_size, atoms, i))
+    {
+        XChangeProperty (clientGetXDisplay (c), c->window, display_info->atoms[NET_WM_ALLOWED_ACTIONS],
+                         XA_ATOM, 32, PropModeReplace, (unsigned char *) atoms, i);
+    }
+}
+
+void
+clientSetNetActions (Client * c)
+{
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    clientQueueNetProps (c, NET_PROPS_ACTIONS);
 }
 
 void
@@ -34,6 +34,8 @@
 #include "client.h"
 
 void                     clientSetNetState                      (Client *);
+void                     clientFlushNetProps                    (Client *);
+void                     clientClearNetProps                    (Client *);
 void                     clientGetNetState                      (Client *);
 void                     clientUpdateNetWmDesktop               (Client *,
                                                                  XClientMessageEvent *);
@@ -46,9 +48,8 @@ void                     clientNetMoveResizeWindow              (Client *,
 void                     clientUpdateFullscreenState            (Client *);
 void                     clientGetNetWmType                     (Client *);
 void                     clientGetInitialNetWmDesktop           (Client *);
-void                     clientSetNetClientList                 (ScreenInfo *,
-                                                                 Atom,
-                                                                 GList *);
+void                     clientQueueNetClientList               (ScreenInfo *);
+void                     clientFlushNetClientList               (ScreenInfo *);
 gboolean                 clientValidateNetStrut                 (Client *);
 gboolean                 clientGetNetStruts                     (Client *);
 void                     clientSetNetActions                    (Client *);
@@ -0,0 +1,212 @@
+/*      $Id$
+
+        This program is free software; you can redistribute it and/or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2, or (at your option)
+        any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program; if not, write to the Free Software
+        Foundation, Inc., Inc., 51 Franklin Street, Fifth Floor, Boston,
+        MA 02110-1301, USA.
+
+
+        xfwm4    - (c) 2002-2015 Olivier Fourdan
+
+ */
+
+/*
+ * Pixel format conversions for the icons and the cursor images that X
+ * hands over as arrays of longs.
+ *
+ * The SSE2 and NEON versions are picked at build time when the compiler
+ * targets them, they process 4 pixels at a time and leave the remainder
+ * to the plain C version, which is also used everywhere else.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "pixel.h"
+
+#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXEL_SSE2
+#elif defined(__ARM_NEON) && (GLIB_SIZEOF_LONG == 8)
+#include <arm_neon.h>
+#define PIXEL_NEON
+#endif
+#endif
+
+#ifdef PIXEL_SSE2
+/* Narrows 4 longs into 4 32-bit pixels */
+static inline __m128i
+pixelLoad4 (const gulong *src)
+{
+#if (GLIB_SIZEOF_LONG == 8)
+    __m128i lo, hi;
+
+    lo = _mm_loadu_si128 ((const __m128i *) src);
+    hi = _mm_loadu_si128 ((const __m128i *) (src + 2));
+    lo = _mm_shuffle_epi32 (lo, _MM_SHUFFLE (3, 1, 2, 0));
+    hi = _mm_shuffle_epi32 (hi, _MM_SHUFFLE (3, 1, 2, 0));
+
+    return _mm_unpacklo_epi64 (lo, hi);
+#else
+    return _mm_loadu_si128 ((const __m128i *) src);
+#endif
+}
+#endif /* PIXEL_SSE2 */
+
+/* Returns the number of pixels converted */
+static guint
+pixelArgbToRgbaSimd (const gulong *src, guchar *dest, guint len)
+{
+    guint i;
+
+    i = 0;
+#if defined(PIXEL_SSE2)
+    {
+        const __m128i mask_ag = _mm_set1_epi32 ((gint) 0xff00ff00);
+        const __m128i mask_rb = _mm_set1_epi32 (0x00ff00ff);
+        __m128i px, rb;
+
+        for (; i + 4 <= len; i += 4)
+        {
+            px = pixelLoad4 (src + i);
+            /* Swap the red and blue bytes of each pixel */
+            rb = _mm_and_si128 (px, mask_rb);
+            rb = _mm_or_si128 (_mm_slli_epi32 (rb, 16), _mm_srli_epi32 (rb, 16));
+            px = _mm_or_si128 (_mm_and_si128 (px, mask_ag), rb);
+            _mm_storeu_si128 ((__m128i *) (dest + i * 4), px);
+        }
+    }
+#elif defined(PIXEL_NEON)
+    {
+        const uint32x4_t mask_ag = vdupq_n_u32 (0xff00ff00);
+        const uint32x4_t mask_rb = vdupq_n_u32 (0x00ff00ff);
+        uint32x4x2_t longs;
+        uint32x4_t px, rb;
+
+        for (; i + 4 <= len; i += 4)
+        {
+            /* The low halves of the longs end up in val[0] */
+            longs = vld2q_u32 ((const uint32_t *) (src + i));
+            px = longs.val[0];
+            rb = vandq_u32 (px, mask_rb);
+            rb = vorrq_u32 (vshlq_n_u32 (rb, 16), vshrq_n_u32 (rb, 16));
+            px = vorrq_u32 (vandq_u32 (px, mask_ag), rb);
+            vst1q_u32 ((uint32_t *) (dest + i * 4), px);
+        }
+    }
+#endif
+
+    return i;
+}
+
+/*
+ * Converts ARGB longs, as found in _NET_WM_ICON, to the RGBA bytes
+ * GdkPixbuf uses.
+ */
+void
+pixelArgbToRgba (const gulong *src, guchar *dest, guint len)
+{
+    guint32 argb;
+    guint i;
+
+    i = pixelArgbToRgbaSimd (src, dest, len);
+    dest += i * 4;
+
+    for (; i < len; i++)
+    {
+        argb = (guint32) src[i];
+        *dest++ = (argb >> 16) & 0xff;
+        *dest++ = (argb >> 8) & 0xff;
+        *dest++ = argb & 0xff;
+        *dest++ = argb >> 24;
+    }
+}
+
+/*
+ * Converts ARGB longs, as returned by XFixesGetCursorImage(), to 32-bit
+ * ARGB pixels.
+ */
+void
+pixelArgbToArgb32 (const gulong *src, guint32 *dest, guint len)
+{
+    guint i;
+
+#if (GLIB_SIZEOF_LONG == 4)
+    memcpy (dest, src, len * sizeof (guint32));
+    i = len;
+#else
+    i = 0;
+#if defined(PIXEL_SSE2)
+    for (; i + 4 <= len; i += 4)
+    {
+        _mm_storeu_si128 ((__m128i *) (dest + i), pixelLoad4 (src + i));
+    }
+#elif defined(PIXEL_NEON)
+    for (; i + 4 <= len; i += 4)
+    {
+        vst1q_u32 (dest + i, vld2q_u32 ((const uint32_t *) (src + i)).val[0]);
+    }
+#endif
+#endif
+
+    for (; i < len; i++)
+    {
+        dest[i] = (guint32) src[i];
+    }
+}
+
+/* Copies the alpha byte of a row of RGBA pixels into another one */
+void
+pixelCopyAlpha (const guchar *src, guchar *dest, guint len)
+{
+    guint i;
+
+    i = 0;
+#if defined(PIXEL_SSE2)
+    {
+        const __m128i mask_a = _mm_set1_epi32 ((gint) 0xff000000);
+        __m128i s, d;
+
+        for (; i + 4 <= len; i += 4)
+        {
+            s = _mm_loadu_si128 ((const __m128i *) (src + i * 4));
+            d = _mm_loadu_si128 ((const __m128i *) (dest + i * 4));
+            d = _mm_or_si128 (_mm_andnot_si128 (mask_a, d), _mm_and_si128 (mask_a, s));
+            _mm_storeu_si128 ((__m128i *) (dest + i * 4), d);
+        }
+    }
+#elif defined(PIXEL_NEON)
+    {
+        const uint32x4_t mask_a = vdupq_n_u32 (0xff000000);
+        uint32x4_t s, d;
+
+        for (; i + 4 <= len; i += 4)
+        {
+            s = vld1q_u32 ((const uint32_t *) (src + i * 4));
+            d = vld1q_u32 ((const uint32_t *) (dest + i * 4));
+            vst1q_u32 ((uint32_t *) (dest + i * 4), vbslq_u32 (mask_a, s, d));
+        }
+    }
+#endif
+
+    for (; i < len; i++)
+    {
+        dest[i * 4 + 3] = src[i * 4 + 3];
+    }
+}
@@ -39,6 +39,7 @@
 #include "workspaces.h"
 #include "frame.h"
 #include "netwm.h"
+#include "spatial.h"
 
 #define MAX_VALID_STRUT(n) (n / 4) /* 25% of available space */
 #define USE_CLIENT_STRUTS(c) (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_VISIBLE) && \
@@ -168,11 +169,53 @@ checkValidStruts (GdkRectangle *struts,
     return TRUE;
 }
 
+/*
+ * Keeps screen_info->strut_clients in sync with the managed clients that
+ * have struts, so the work area and the constraints only look at those.
+ */
+void
+strutsIndexUpdate (Client *c)
+{
+    ScreenInfo *screen_info;
+
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    if (!FLAG_TEST (c->flags, CLIENT_FLAG_HAS_STRUT) || !FLAG_TEST (c->xfwm_flags, XFWM_FLAG_MANAGED))
+    {
+        strutsIndexRemove (c);
+        return;
+    }
+
+    if (!c->strut_indexed)
+    {
+        screen_info = c->screen_info;
+        screen_info->strut_clients = g_list_append (screen_info->strut_clients, c);
+        c->strut_indexed = TRUE;
+    }
+}
+
+void
+strutsIndexRemove (Client *c)
+{
+    ScreenInfo *screen_info;
+
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    if (c->strut_indexed)
+    {
+        screen_info = c->screen_info;
+        screen_info->strut_clients = g_list_remove (screen_info->strut_clients, c);
+        c->strut_indexed = FALSE;
+    }
+}
+
 void
 clientMaxSpace (ScreenInfo *screen_info, int *x, int *y, int *w, int *h)
 {
     Client *c;
-    guint i;
+    GList *list;
     GdkRectangle top, left, right, bottom, area, initial, intersect;
 
     g_return_if_fail (x != NULL);
@@ -183,8 +226,9 @@ clientMaxSpace (ScreenInfo *screen_info, int *x, int *y, int *w, int *h)
     set_rectangle (&area, *x, *y, *w, *h);
     set_rectangle (&initial, *x, *y, *w, *h);
 
-    for (c = screen_info->clients, i = 0; i < screen_info->client_count; c = c->next, i++)
+    for (list = screen_info->strut_clients; list; list = g_list_next (list))
     {
+        c = (Client *) list->data;
         if (!USE_CLIENT_STRUTS(c))
         {
             continue;
@@ -244,7 +288,7 @@ clientConstrainPos (Client * c, gboolean show_full)
 {
     Client *c2;
     ScreenInfo *screen_info;
-    guint i;
+    GList *list;
     gint cx, cy;
     gint frame_top, frame_left;
     gint title_visible;
@@ -289,8 +333,9 @@ clientConstrainPos (Client * c, gboolean show_full)
     }
     if (show_full)
     {
-        for (c2 = screen_info->clients, i = 0; i < screen_info->client_count; c2 = c2->next, i++)
+        for (list = screen_info->strut_clients; list; list = g_list_next (list))
         {
+            c2 = (Client *) list->data;
             if ((c2 == c) || !strutsToRectangles (c2, &left, &right, &top, &bottom))
             {
                 continue;
@@ -340,8 +385,9 @@ clientConstrainPos (Client * c, gboolean show_full)
             ret |= CLIENT_CONSTRAINED_TOP;
         }
 
-        for (c2 = screen_info->clients, i = 0; i < screen_info->client_count; c2 = c2->next, i++)
+        for (list = screen_info->strut_clients; list; list = g_list_next (list))
         {
+            c2 = (Client *) list->data;
             if ((c2 == c) || !strutsToRectangles (c2, &left, &right, &top, &bottom))
             {
                 continue;
@@ -400,8 +446,9 @@ clientConstrainPos (Client * c, gboolean show_full)
         }
 
         /* Struts and other partial struts */
-        for (c2 = screen_info->clients, i = 0; i < screen_info->client_count; c2 = c2->next, i++)
+        for (list = screen_info->strut_clients; list; list = g_list_next (list))
         {
+            c2 = (Client *) list->data;
             if ((c2 == c) || !strutsToRectangles (c2, &left, &right, &top, &bottom))
             {
                 continue;
@@ -545,8 +592,9 @@ smartPlacement (Client * c, int full_x, int full_y, int full_w, int full_h)
 {
     Client *c2;
     ScreenInfo *screen_info;
+    GList *candidates;
+    GList *list;
     gfloat best_overlaps;
-    guint i;
     gint test_x, test_y, xmax, ymax, best_x, best_y;
     gint frame_height, frame_width, frame_left, frame_top;
     gint c2_x, c2_y;
@@ -575,7 +623,10 @@ smartPlacement (Client * c, int full_x, int full_y, int full_w, int full_h)
     best_x = xmin;
     best_y = ymin;
 
-    TRACE ("analyzing %i clients", screen_info->client_count);
+    /* Only the clients on this workspace and monitor can overlap */
+    candidates = spatialIndexQuery (screen_info, c->win_workspace, full_x, full_y, full_w, full_h);
+
+    TRACE ("analyzing %i clients", g_list_length (candidates));
 
     test_y = ymin;
     do
@@ -597,8 +648,9 @@ smartPlacement (Client * c, int full_x, int full_y, int full_w, int full_h)
 
             TRACE ("testing x position %d", test_x);
 
-            for (c2 = screen_info->clients, i = 0; i < screen_info->client_count; c2 = c2->next, i++)
+            for (list = candidates; list; list = g_list_next (list))
             {
+                c2 = (Client *) list->data;
                 if ((c2 != c) && (c2->type != WINDOW_DESKTOP)
                     && (c->win_workspace == c2->win_workspace)
                     && FLAG_TEST (c2->xfwm_flags, XFWM_FLAG_VISIBLE))
@@ -717,6 +769,8 @@ smartPlacement (Client * c, int full_x, int full_y, int full_w, int full_h)
 
     found_best:
 
+    g_list_free (candidates);
+
     TRACE ("overlaps %f at %d,%d (x,y)", best_overlaps, best_x, best_y);
 
     c->x = best_x;
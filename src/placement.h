@@ -43,6 +43,8 @@ gboolean                 strutsToRectangles                     (Client *,
 gboolean                 checkValidStruts                       (GdkRectangle * /* struts */,
                                                                  GdkRectangle * /* monitor */,
                                                                  int);
+void                     strutsIndexUpdate                      (Client *);
+void                     strutsIndexRemove                      (Client *);
 void                     clientMaxSpace                         (ScreenInfo *,
                                                                  int *,
                                                                  int *,
@@ -50,8 +50,13 @@
 #include "screen.h"
 #include "misc.h"
 #include "mywindow.h"
+#include "netwm.h"
 #include "compositor.h"
+#include "frame.h"
+#include "spatial.h"
+#include "tabwin.h"
 #include "ui_style.h"
+#include "workspaces.h"
 
 #ifndef WM_EXITING_TIMEOUT
 #define WM_EXITING_TIMEOUT 15 /*seconds */
@@ -243,11 +248,27 @@ myScreenInit (DisplayInfo *display_info, GdkScreen *gscr, unsigned long event_ma
     screen_info->workspace_names_items = 0;
 
     screen_info->windows_stack = NULL;
+    screen_info->applied_stack = NULL;
+    screen_info->applied_stack_size = 0;
     screen_info->last_raise = NULL;
     screen_info->windows = NULL;
     screen_info->clients = NULL;
     screen_info->client_count = 0;
     screen_info->client_serial = 0L;
+    spatialIndexInit (screen_info);
+    screen_info->strut_clients = NULL;
+    workspaceIndexInit (screen_info);
+    screen_info->stack_positions_valid = FALSE;
+    screen_info->ring_first = 0;
+    screen_info->ring_last = 0;
+    frameTilesInit (screen_info);
+    screen_info->frame_queue = NULL;
+    screen_info->frame_queue_id = 0;
+    screen_info->net_client_list = g_array_new (FALSE, FALSE, sizeof (Window));
+    screen_info->net_client_list_stacking = g_array_new (FALSE, FALSE, sizeof (Window));
+    screen_info->net_client_list_id = 0;
+    screen_info->net_props_queue = NULL;
+    screen_info->net_props_queue_id = 0;
     screen_info->button_handler_id = 0L;
 
     screen_info->key_grabs = 0;
@@ -306,7 +327,15 @@ myScreenInit (DisplayInfo *display_info, GdkScreen *gscr, unsigned long event_ma
 
     screen_info->font_height = 0;
     screen_info->font_desc = NULL;
+    screen_info->theme_generation = 0;
+    screen_info->opaque_theme = FALSE;
+    screen_info->dual_state = FALSE;
+    screen_info->theme_cache = NULL;
+    screen_info->tabwin = NULL;
+    screen_info->area_freeze = 0;
+    screen_info->area_pending = FALSE;
     screen_info->box_gc = None;
+    screen_info->gc_pool = g_hash_table_new (g_direct_hash, g_direct_equal);
 
     for (i = 0; i < SIDE_COUNT; i++)
     {
@@ -351,6 +380,8 @@ myScreenClose (ScreenInfo *screen_info)
     display_info = screen_info->display_info;
 
     clientUnframeAll (screen_info);
+    clientFlushNetClientList (screen_info);
+    tabwinClose (screen_info);
     compositorUnmanageScreen (screen_info);
     closeSettings (screen_info);
 
@@ -382,9 +413,38 @@ myScreenClose (ScreenInfo *screen_info)
     g_list_free (screen_info->windows_stack);
     screen_info->windows_stack = NULL;
 
+    g_free (screen_info->applied_stack);
+    screen_info->applied_stack = NULL;
+    screen_info->applied_stack_size = 0;
+
     g_list_free (screen_info->windows);
     screen_info->windows = NULL;
 
+    g_array_free (screen_info->net_client_list, TRUE);
+    screen_info->net_client_list = NULL;
+    g_array_free (screen_info->net_client_list_stacking, TRUE);
+    screen_info->net_client_list_stacking = NULL;
+
+    spatialIndexClose (screen_info);
+    g_list_free (screen_info->strut_clients);
+    screen_info->strut_clients = NULL;
+    workspaceIndexClose (screen_info);
+    frameTilesClose (screen_info);
+
+    if (screen_info->gc_pool)
+    {
+        GHashTableIter iter;
+        gpointer gc;
+
+        g_hash_table_iter_init (&iter, screen_info->gc_pool);
+        while (g_hash_table_iter_next (&iter, NULL, &gc))
+        {
+            XFreeGC (myScreenGetXDisplay (screen_info), (GC) gc);
+        }
+        g_hash_table_destroy (screen_info->gc_pool);
+        screen_info->gc_pool = NULL;
+    }
+
     if (screen_info->monitors_index)
     {
         g_array_free (screen_info->monitors_index, TRUE);
@@ -406,6 +466,33 @@ myScreenGetXDisplay (ScreenInfo *screen_info)
     return display_info->dpy;
 }
 
+/*
+ * Returns a GC shared by all users of the given depth and fill style,
+ * callers set the other values they need with XChangeGC() and must not
+ * free it. The drawable is only used to create the GC the first time.
+ */
+GC
+myScreenGetPooledGC (ScreenInfo *screen_info, Drawable d, guint depth, int fill_style)
+{
+    XGCValues gv;
+    gpointer key;
+    GC gc;
+
+    g_return_val_if_fail (screen_info, None);
+    g_return_val_if_fail (d != None, None);
+
+    key = GUINT_TO_POINTER ((depth << 4) | (fill_style & 0xf));
+    gc = (GC) g_hash_table_lookup (screen_info->gc_pool, key);
+    if (gc == NULL)
+    {
+        gv.fill_style = fill_style;
+        gc = XCreateGC (myScreenGetXDisplay (screen_info), d, GCFillStyle, &gv);
+        g_hash_table_insert (screen_info->gc_pool, key, (gpointer) gc);
+    }
+
+    return gc;
+}
+
 GtkWidget *
 myScreenGetGtkWidget (ScreenInfo *screen_info)
 {
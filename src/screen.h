@@ -77,10 +77,31 @@ struct _ScreenInfo
 
     /* Window stacking, per screen */
     GList *windows_stack;
+    Window *applied_stack;
+    guint applied_stack_size;
     Client *last_raise;
     GList *windows;
     Client *clients;
     guint client_count;
+    GHashTable *spatial_index;
+    guint spatial_stamp;
+    GHashTable *workspace_index;
+    gboolean stack_positions_valid;
+    gint64 ring_first;
+    gint64 ring_last;
+    /* Managed clients with struts, see strutsIndexUpdate() */
+    GList *strut_clients;
+    GHashTable *frame_tiles;
+    /* Clients waiting for a frame redraw, see frameQueueDrawParts() */
+    GList *frame_queue;
+    guint frame_queue_id;
+    /* Last written _NET_CLIENT_LIST and _NET_CLIENT_LIST_STACKING */
+    GArray *net_client_list;
+    GArray *net_client_list_stacking;
+    guint net_client_list_id;
+    /* Clients with _NET_WM_STATE or _NET_WM_ALLOWED_ACTIONS to write */
+    GList *net_props_queue;
+    guint net_props_queue_id;
     unsigned long client_serial;
     gint key_grabs;
     gint pointer_grabs;
@@ -96,11 +117,26 @@ struct _ScreenInfo
 
     /* Per screen graphic contexts */
     GC box_gc;
+    GHashTable *gc_pool;
 
     /* Title font */
     gint font_height;
     PangoFontDescription *font_desc;
 
+    /* Bumped each time the theme is (re)loaded */
+    guint theme_generation;
+    /* No theme part has transparent pixels, see frameSetShape() */
+    gboolean opaque_theme;
+    /* ACTIVE and INACTIVE parts have the same sizes, see frameSwapState() */
+    gboolean dual_state;
+    /* Decoded parts of the current theme, see themecache.c */
+    ThemeCache *theme_cache;
+    /* Pending work area update, see workspaceFreezeArea() */
+    gint area_freeze;
+    gboolean area_pending;
+    /* Window switcher, kept hidden between cycles, see tabwin.c */
+    Tabwin *tabwin;
+
     /* Screen data */
     Colormap cmap;
     GdkScreen *gscr;
@@ -239,6 +275,10 @@ ScreenInfo              *myScreenClose                          (ScreenInfo *);
 Display                 *myScreenGetXDisplay                    (ScreenInfo *);
 GtkWidget               *myScreenGetGtkWidget                   (ScreenInfo *);
 GdkWindow               *myScreenGetGdkWindow                   (ScreenInfo *);
+GC                       myScreenGetPooledGC                    (ScreenInfo *,
+                                                                 Drawable,
+                                                                 guint,
+                                                                 int);
 gboolean                 myScreenGrabKeyboard                   (ScreenInfo *,
                                                                  guint,
                                                                  guint32);
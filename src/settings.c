@@ -43,6 +43,7 @@
 #include "workspaces.h"
 #include "compositor.h"
 #include "ui_style.h"
+#include "themecache.h"
 
 #define CHANNEL_XFWM            "xfwm4"
 #define THEMERC                 "themerc"
@@ -265,6 +266,98 @@ getTitleShadow (Settings *rc, const gchar * name)
     return TITLE_SHADOW_NONE;
 }
 
+static gboolean
+themeIsOpaque (ScreenInfo *screen_info)
+{
+    guint i, j;
+
+    for (j = 0; j < 2; j++)
+    {
+        for (i = 0; i < SIDE_COUNT; i++)
+        {
+            if (!xfwmPixmapOpaque (&screen_info->sides[i][j]))
+            {
+                return FALSE;
+            }
+        }
+        for (i = 0; i < CORNER_COUNT; i++)
+        {
+            if (!xfwmPixmapOpaque (&screen_info->corners[i][j]))
+            {
+                return FALSE;
+            }
+        }
+        for (i = 0; i < TITLE_COUNT; i++)
+        {
+            if (!xfwmPixmapOpaque (&screen_info->title[i][j]) ||
+                !xfwmPixmapOpaque (&screen_info->top[i][j]))
+            {
+                return FALSE;
+            }
+        }
+    }
+    for (i = 0; i < BUTTON_COUNT; i++)
+    {
+        for (j = 0; j < STATE_COUNT; j++)
+        {
+            if (!xfwmPixmapOpaque (&screen_info->buttons[i][j]))
+            {
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+themeSameSize (xfwmPixmap *a, xfwmPixmap *b)
+{
+    if (xfwmPixmapNone (a) || xfwmPixmapNone (b))
+    {
+        return (xfwmPixmapNone (a) == xfwmPixmapNone (b));
+    }
+    return ((a->width == b->width) && (a->height == b->height));
+}
+
+static gboolean
+themeHasDualState (ScreenInfo *screen_info)
+{
+    guint i;
+
+    for (i = 0; i < SIDE_COUNT; i++)
+    {
+        if (!themeSameSize (&screen_info->sides[i][ACTIVE], &screen_info->sides[i][INACTIVE]))
+        {
+            return FALSE;
+        }
+    }
+    for (i = 0; i < CORNER_COUNT; i++)
+    {
+        if (!themeSameSize (&screen_info->corners[i][ACTIVE], &screen_info->corners[i][INACTIVE]))
+        {
+            return FALSE;
+        }
+    }
+    for (i = 0; i < TITLE_COUNT; i++)
+    {
+        if (!themeSameSize (&screen_info->title[i][ACTIVE], &screen_info->title[i][INACTIVE]) ||
+            !themeSameSize (&screen_info->top[i][ACTIVE], &screen_info->top[i][INACTIVE]))
+        {
+            return FALSE;
+        }
+    }
+    for (i = 0; i < BUTTON_COUNT; i++)
+    {
+        if (!themeSameSize (&screen_info->buttons[i][ACTIVE], &screen_info->buttons[i][INACTIVE]))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
 static void
 loadTheme (ScreenInfo *screen_info, Settings *rc)
 {
@@ -364,6 +457,7 @@ loadTheme (ScreenInfo *screen_info, Settings *rc)
     GValue tmp_val2 = { 0, };
     DisplayInfo *display_info;
     xfwmColorSymbol colsym[ XPM_COLOR_SYMBOL_SIZE + 1 ];
+    ThemeCache *cache;
     GtkWidget *widget;
     gchar *theme;
     const gchar *font;
@@ -372,6 +466,9 @@ loadTheme (ScreenInfo *screen_info, Settings *rc)
     widget = myScreenGetGtkWidget (screen_info);
     display_info = screen_info->display_info;
 
+    /* Invalidates everything rendered with the previous theme */
+    screen_info->theme_generation++;
+
     i = 0;
 
     /* Load gtk theme colors first */
@@ -458,47 +555,55 @@ loadTheme (ScreenInfo *screen_info, Settings *rc)
     gdk_rgba_parse (&screen_info->title_shadow_colors[ACTIVE], getStringValue ("active_text_shadow_color", rc));
     gdk_rgba_parse (&screen_info->title_shadow_colors[INACTIVE], getStringValue ("inactive_text_shadow_color", rc));
 
+    cache = themeCacheOpen (theme, colsym);
     for (i = 0; i < SIDE_COUNT; i++)
     {
         if (i == SIDE_TOP)
             continue;  /* There is no top decoration per se. */
 
         g_snprintf(imagename, sizeof (imagename), "%s-active", side_names[i]);
-        xfwmPixmapLoad (screen_info, &screen_info->sides[i][ACTIVE], theme, imagename, colsym);
+        xfwmPixmapLoad (screen_info, &screen_info->sides[i][ACTIVE], cache, theme, imagename, colsym);
 
         g_snprintf(imagename, sizeof (imagename), "%s-inactive", side_names[i]);
-        xfwmPixmapLoad (screen_info, &screen_info->sides[i][INACTIVE], theme, imagename, colsym);
+        xfwmPixmapLoad (screen_info, &screen_info->sides[i][INACTIVE], cache, theme, imagename, colsym);
     }
     for (i = 0; i < CORNER_COUNT; i++)
     {
         g_snprintf(imagename, sizeof (imagename), "%s-active", corner_names[i]);
-        xfwmPixmapLoad (screen_info, &screen_info->corners[i][ACTIVE], theme, imagename, colsym);
+        xfwmPixmapLoad (screen_info, &screen_info->corners[i][ACTIVE], cache, theme, imagename, colsym);
 
         g_snprintf(imagename, sizeof (imagename), "%s-inactive", corner_names[i]);
-        xfwmPixmapLoad (screen_info, &screen_info->corners[i][INACTIVE], theme, imagename, colsym);
+        xfwmPixmapLoad (screen_info, &screen_info->corners[i][INACTIVE], cache, theme, imagename, colsym);
     }
     for (i = 0; i < BUTTON_COUNT; i++)
     {
         for (j = 0; j < STATE_COUNT; j++)
         {
             g_snprintf(imagename, sizeof (imagename), "%s-%s", button_names[i], button_state_names[j]);
-            xfwmPixmapLoad (screen_info, &screen_info->buttons[i][j], theme, imagename, colsym);
+            xfwmPixmapLoad (screen_info, &screen_info->buttons[i][j], cache, theme, imagename, colsym);
         }
     }
     for (i = 0; i < TITLE_COUNT; i++)
     {
         g_snprintf(imagename, sizeof (imagename), "title-%d-active", i + 1);
-        xfwmPixmapLoad (screen_info, &screen_info->title[i][ACTIVE], theme, imagename, colsym);
+        xfwmPixmapLoad (screen_info, &screen_info->title[i][ACTIVE], cache, theme, imagename, colsym);
 
         g_snprintf(imagename, sizeof (imagename), "title-%d-inactive", i + 1);
-        xfwmPixmapLoad (screen_info, &screen_info->title[i][INACTIVE], theme, imagename, colsym);
+        xfwmPixmapLoad (screen_info, &screen_info->title[i][INACTIVE], cache, theme, imagename, colsym);
 
         g_snprintf(imagename, sizeof (imagename), "top-%d-active", i + 1);
-        xfwmPixmapLoad (screen_info, &screen_info->top[i][ACTIVE], theme, imagename, colsym);
+        xfwmPixmapLoad (screen_info, &screen_info->top[i][ACTIVE], cache, theme, imagename, colsym);
 
         g_snprintf(imagename, sizeof (imagename), "top-%d-inactive", i + 1);
-        xfwmPixmapLoad (screen_info, &screen_info->top[i][INACTIVE], theme, imagename, colsym);
+        xfwmPixmapLoad (screen_info, &screen_info->top[i][INACTIVE], cache, theme, imagename, colsym);
     }
+    themeCacheSave (cache);
+    /* Released only now so that a reload of the same theme can reuse it */
+    themeCacheClose (screen_info->theme_cache);
+    screen_info->theme_cache = cache;
+    screen_info->opaque_theme = themeIsOpaque (screen_info);
+    TRACE ("theme is %s", screen_info->opaque_theme ? "opaque" : "shaped");
+    screen_info->dual_state = themeHasDualState (screen_info);
 
     screen_info->box_gc = createGC (screen_info, "#FFFFFF", GXxor, NULL, 2, TRUE);
 
@@ -1066,6 +1171,8 @@ closeSettings (ScreenInfo *screen_info)
     g_return_if_fail (screen_info);
 
     unloadSettings (screen_info);
+    themeCacheClose (screen_info->theme_cache);
+    screen_info->theme_cache = NULL;
 }
 
 static void
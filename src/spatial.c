@@ -0,0 +1,236 @@
+/*      $Id$
+
+        This program is free software; you can redistribute it and/or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2, or (at your option)
+        any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program; if not, write to the Free Software
+        Foundation, Inc., Inc., 51 Franklin Street, Fifth Floor, Boston,
+        MA 02110-1301, USA.
+
+
+        xfwm4    - (c) 2002-2015 Olivier Fourdan
+
+ */
+
+/*
+ * Per workspace grid of the clients' frame extents, so that placement,
+ * snapping and pointer lookups only need to look at the clients close
+ * to a given area instead of walking the whole client list.
+ *
+ * Each client is listed in all the cells its frame covers, the cells are
+ * stored in a hash table keyed by workspace and cell coordinates.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <X11/Xlib.h>
+#include <glib.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "screen.h"
+#include "client.h"
+#include "frame.h"
+#include "spatial.h"
+
+#ifndef SPATIAL_CELL_SIZE
+#define SPATIAL_CELL_SIZE               256
+#endif
+
+#define SPATIAL_CELL_MAX                0xfff
+#define SPATIAL_KEY(ws, cx, cy)         GUINT_TO_POINTER ((((ws) & 0xff) << 24) | ((cy) << 12) | (cx))
+
+static gint
+spatialCell (gint pos)
+{
+    if (pos < 0)
+    {
+        return 0;
+    }
+    return MIN (pos / SPATIAL_CELL_SIZE, SPATIAL_CELL_MAX);
+}
+
+static void
+spatialIndexGetBounds (Client *c, gint *x1, gint *y1, gint *x2, gint *y2)
+{
+    gint fx, fy;
+
+    /* Cover the client, its frame and its frame extents, whichever is larger */
+    fx = frameExtentX (c);
+    fy = frameExtentY (c);
+    *x1 = MIN (MIN (c->x, frameX (c)), fx);
+    *y1 = MIN (MIN (c->y, frameY (c)), fy);
+    *x2 = MAX (MAX (c->x + c->width, frameX (c) + frameWidth (c)), fx + frameExtentWidth (c));
+    *y2 = MAX (MAX (c->y + c->height, frameY (c) + frameHeight (c)), fy + frameExtentHeight (c));
+}
+
+static void
+spatialIndexLink (Client *c, gboolean add)
+{
+    ScreenInfo *screen_info;
+    GList *cell;
+    gpointer key;
+    gint cx, cy;
+
+    screen_info = c->screen_info;
+    for (cy = c->spatial_cells[1]; cy <= c->spatial_cells[3]; cy++)
+    {
+        for (cx = c->spatial_cells[0]; cx <= c->spatial_cells[2]; cx++)
+        {
+            key = SPATIAL_KEY (c->spatial_ws, cx, cy);
+            cell = (GList *) g_hash_table_lookup (screen_info->spatial_index, key);
+            if (add)
+            {
+                cell = g_list_prepend (cell, c);
+            }
+            else
+            {
+                cell = g_list_remove (cell, c);
+            }
+
+            if (cell)
+            {
+                g_hash_table_insert (screen_info->spatial_index, key, cell);
+            }
+            else
+            {
+                g_hash_table_remove (screen_info->spatial_index, key);
+            }
+        }
+    }
+}
+
+static void
+spatialIndexFreeCell (gpointer key, gpointer value, gpointer data)
+{
+    g_list_free ((GList *) value);
+}
+
+void
+spatialIndexInit (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+
+    screen_info->spatial_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+    screen_info->spatial_stamp = 0;
+}
+
+void
+spatialIndexClose (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+
+    if (screen_info->spatial_index)
+    {
+        g_hash_table_foreach (screen_info->spatial_index, spatialIndexFreeCell, NULL);
+        g_hash_table_destroy (screen_info->spatial_index);
+        screen_info->spatial_index = NULL;
+    }
+}
+
+void
+spatialIndexUpdate (Client *c)
+{
+    gint x1, y1, x2, y2;
+    gint cells[4];
+
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    /* Only managed clients are indexed, so they get removed when unmanaged */
+    if (!c->screen_info->spatial_index || !FLAG_TEST (c->xfwm_flags, XFWM_FLAG_MANAGED))
+    {
+        return;
+    }
+
+    spatialIndexGetBounds (c, &x1, &y1, &x2, &y2);
+    cells[0] = spatialCell (x1);
+    cells[1] = spatialCell (y1);
+    cells[2] = spatialCell (x2);
+    cells[3] = spatialCell (y2);
+
+    if (c->spatial_indexed)
+    {
+        if ((c->spatial_ws == c->win_workspace) &&
+            (memcmp (cells, c->spatial_cells, sizeof (cells)) == 0))
+        {
+            /* Still in the same cells, nothing to do */
+            return;
+        }
+        spatialIndexLink (c, FALSE);
+    }
+
+    memcpy (c->spatial_cells, cells, sizeof (cells));
+    c->spatial_ws = c->win_workspace;
+    c->spatial_indexed = TRUE;
+    spatialIndexLink (c, TRUE);
+}
+
+void
+spatialIndexRemove (Client *c)
+{
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    if (c->spatial_indexed && c->screen_info->spatial_index)
+    {
+        spatialIndexLink (c, FALSE);
+    }
+    c->spatial_indexed = FALSE;
+}
+
+/*
+ * Returns the list of clients on workspace "ws" whose frame may intersect
+ * the given area (edges included). The caller must free the list and still
+ * check the actual geometry of the returned clients.
+ */
+GList *
+spatialIndexQuery (ScreenInfo *screen_info, guint ws, gint x, gint y, gint width, gint height)
+{
+    GList *result;
+    GList *cell;
+    Client *c;
+    gint cx1, cy1, cx2, cy2;
+    gint cx, cy;
+
+    g_return_val_if_fail (screen_info != NULL, NULL);
+    g_return_val_if_fail (screen_info->spatial_index != NULL, NULL);
+
+    cx1 = spatialCell (x);
+    cy1 = spatialCell (y);
+    cx2 = spatialCell (x + MAX (width, 0));
+    cy2 = spatialCell (y + MAX (height, 0));
+
+    /* Use a stamp to report each client only once */
+    screen_info->spatial_stamp++;
+    result = NULL;
+    for (cy = cy1; cy <= cy2; cy++)
+    {
+        for (cx = cx1; cx <= cx2; cx++)
+        {
+            cell = (GList *) g_hash_table_lookup (screen_info->spatial_index, SPATIAL_KEY (ws, cx, cy));
+            for (; cell; cell = g_list_next (cell))
+            {
+                c = (Client *) cell->data;
+                if (c->spatial_stamp != screen_info->spatial_stamp)
+                {
+                    c->spatial_stamp = screen_info->spatial_stamp;
+                    result = g_list_prepend (result, c);
+                }
+            }
+        }
+    }
+
+    return result;
+}
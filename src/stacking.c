@@ -24,6 +24,8 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
@@ -39,21 +41,122 @@
 #include "transients.h"
 #include "frame.h"
 #include "focus.h"
+#include "placement.h"
+#include "spatial.h"
+#include "workspaces.h"
+
+/* Restack all windows when more than 1/MAX_RESTACK_RATIO of them moved */
+#ifndef MAX_RESTACK_RATIO
+#define MAX_RESTACK_RATIO               2
+#endif
 
 static guint raise_timeout = 0;
 
+/*
+ * Mark in "keep" the windows of "xwinstack" which form the longest sequence
+ * already in the right relative order in the previously applied stack, so
+ * that these do not need to be restacked. Returns the number of windows
+ * which need to be moved.
+ */
+static guint
+clientStackListDiff (ScreenInfo *screen_info, Window *xwinstack, guint size, gboolean *keep)
+{
+    GHashTable *previous;
+    gint *position;
+    gint *tails;
+    gint *prev;
+    gint len, lo, hi, mid;
+    guint i, kept;
+
+    previous = g_hash_table_new (g_direct_hash, g_direct_equal);
+    for (i = 0; i < screen_info->applied_stack_size; i++)
+    {
+        g_hash_table_insert (previous,
+                             GUINT_TO_POINTER (screen_info->applied_stack[i]),
+                             GUINT_TO_POINTER (i + 1));
+    }
+
+    position = g_new (gint, size);
+    tails = g_new (gint, size);
+    prev = g_new (gint, size);
+
+    /* Longest increasing subsequence of the previous positions */
+    len = 0;
+    for (i = 0; i < size; i++)
+    {
+        keep[i] = FALSE;
+        prev[i] = -1;
+        position[i] = GPOINTER_TO_INT (g_hash_table_lookup (previous, GUINT_TO_POINTER (xwinstack[i]))) - 1;
+        if (position[i] < 0)
+        {
+            /* Not in the previous stack, needs to be placed */
+            continue;
+        }
+
+        lo = 0;
+        hi = len;
+        while (lo < hi)
+        {
+            mid = (lo + hi) / 2;
+            if (position[tails[mid]] < position[i])
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        if (lo > 0)
+        {
+            prev[i] = tails[lo - 1];
+        }
+        tails[lo] = (gint) i;
+        if (lo == len)
+        {
+            len++;
+        }
+    }
+
+    kept = 0;
+    if (len > 0)
+    {
+        for (mid = tails[len - 1]; mid >= 0; mid = prev[mid])
+        {
+            keep[mid] = TRUE;
+            kept++;
+        }
+    }
+
+    g_free (prev);
+    g_free (tails);
+    g_free (position);
+    g_hash_table_destroy (previous);
+
+    return size - kept;
+}
+
 void
 clientApplyStackList (ScreenInfo *screen_info)
 {
+    Display *dpy;
     Window *xwinstack;
+    XWindowChanges wc;
+    gboolean *keep;
     guint nwindows;
+    guint moves;
+    guint size;
     gint i;
 
     DBG ("applying stack list");
+    /* The stack changed, positions are recomputed when next needed */
+    screen_info->stack_positions_valid = FALSE;
+    dpy = myScreenGetXDisplay (screen_info);
     nwindows = g_list_length (screen_info->windows_stack);
+    size = nwindows + 4;
 
     i = 0;
-    xwinstack = g_new (Window, nwindows + 4);
+    xwinstack = g_new (Window, size);
     xwinstack[i++] = MYWINDOW_XWINDOW (screen_info->sidewalk[0]);
     xwinstack[i++] = MYWINDOW_XWINDOW (screen_info->sidewalk[1]);
     xwinstack[i++] = MYWINDOW_XWINDOW (screen_info->sidewalk[2]);
@@ -72,9 +175,57 @@ clientApplyStackList (ScreenInfo *screen_info)
         }
     }
 
-    XRestackWindows (myScreenGetXDisplay (screen_info), xwinstack, (int) nwindows + 4);
+    if (screen_info->applied_stack == NULL)
+    {
+        XRestackWindows (dpy, xwinstack, (int) size);
+    }
+    else
+    {
+        keep = g_new (gboolean, size);
+        moves = clientStackListDiff (screen_info, xwinstack, size, keep);
+
+        /* The top-most window is used as reference, it cannot move */
+        if (!keep[0] || (moves * MAX_RESTACK_RATIO > size))
+        {
+            DBG ("%u windows to restack out of %u, restacking all", moves, size);
+            XRestackWindows (dpy, xwinstack, (int) size);
+        }
+        else if (moves > 0)
+        {
+            DBG ("%u windows to restack out of %u", moves, size);
+            wc.stack_mode = Below;
+            for (i = 1; i < (gint) size; i++)
+            {
+                if (!keep[i])
+                {
+                    wc.sibling = xwinstack[i - 1];
+                    XConfigureWindow (dpy, xwinstack[i], CWSibling | CWStackMode, &wc);
+                }
+            }
+        }
+        g_free (keep);
+    }
+
+    g_free (screen_info->applied_stack);
+    screen_info->applied_stack = xwinstack;
+    screen_info->applied_stack_size = size;
+}
 
-    g_free (xwinstack);
+static void
+clientForgetAppliedStack (ScreenInfo *screen_info, Window w)
+{
+    guint i;
+
+    for (i = 0; i < screen_info->applied_stack_size; i++)
+    {
+        if (screen_info->applied_stack[i] == w)
+        {
+            screen_info->applied_stack_size--;
+            memmove (&screen_info->applied_stack[i], &screen_info->applied_stack[i + 1],
+                     (screen_info->applied_stack_size - i) * sizeof (Window));
+            return;
+        }
+    }
 }
 
 Client *
@@ -255,15 +406,31 @@ clientGetBottomMost (ScreenInfo *screen_info, guint layer, Client * exclude)
 Client *
 clientAtPosition (ScreenInfo *screen_info, int x, int y, GList * exclude_list)
 {
+    GList *candidates;
     GList *list;
     Client *c, *c2;
+    guint remaining;
 
     TRACE ("(%i,%i)", x, y);
 
     c = NULL;
-    for (list = g_list_last (screen_info->windows_stack); list; list = g_list_previous (list))
+    candidates = spatialIndexQuery (screen_info, screen_info->current_ws, x, y, 0, 0);
+    remaining = g_list_length (candidates);
+
+    g_list_free (candidates);
+
+    /*
+     * Walk the stack from the top until all the candidates have been seen,
+     * the query stamped them so telling them apart is a single test.
+     */
+    for (list = g_list_last (screen_info->windows_stack); list && remaining; list = g_list_previous (list))
     {
         c2 = (Client *) list->data;
+        if (c2->spatial_stamp != screen_info->spatial_stamp)
+        {
+            continue;
+        }
+        remaining--;
         if ((frameX (c2) <= x) && (frameX (c2) + frameWidth (c2) >= x)
             && (frameY (c2) <= y) && (frameY (c2) + frameHeight (c2) >= y))
         {
@@ -433,7 +600,7 @@ clientRaise (Client * c, Window wsibling)
            We still need to tell the X Server to reflect the changes
          */
         clientApplyStackList (screen_info);
-        clientSetNetClientList (c->screen_info, display_info->atoms[NET_CLIENT_LIST_STACKING], screen_info->windows_stack);
+        clientQueueNetClientList (screen_info);
         screen_info->last_raise = c;
     }
 }
@@ -521,7 +688,7 @@ clientLower (Client * c, Window wsibling)
            We still need to tell the X Server to reflect the changes
          */
         clientApplyStackList (screen_info);
-        clientSetNetClientList (screen_info, display_info->atoms[NET_CLIENT_LIST_STACKING], screen_info->windows_stack);
+        clientQueueNetClientList (screen_info);
         clientPassFocus (screen_info, c, NULL);
         if (screen_info->last_raise == c)
         {
@@ -585,12 +752,18 @@ clientAddToList (Client * c)
         c->prev = c;
     }
 
+    c->ring_key = ++screen_info->ring_last;
+
     screen_info->windows = g_list_append (screen_info->windows, c);
     screen_info->windows_stack = g_list_append (screen_info->windows_stack, c);
+    screen_info->stack_positions_valid = FALSE;
 
-    clientSetNetClientList (screen_info, display_info->atoms[NET_CLIENT_LIST], screen_info->windows);
+    clientQueueNetClientList (screen_info);
 
     FLAG_SET (c->xfwm_flags, XFWM_FLAG_MANAGED);
+    spatialIndexUpdate (c);
+    workspaceIndexUpdate (c);
+    strutsIndexUpdate (c);
 }
 
 void
@@ -626,9 +799,14 @@ clientRemoveFromList (Client * c)
 
     screen_info->windows = g_list_remove (screen_info->windows, c);
     screen_info->windows_stack = g_list_remove (screen_info->windows_stack, c);
+    screen_info->stack_positions_valid = FALSE;
+    /* The frame is about to be destroyed, do not reuse its position */
+    clientForgetAppliedStack (screen_info, c->frame);
+    spatialIndexRemove (c);
+    workspaceIndexRemove (c);
+    strutsIndexRemove (c);
 
-    clientSetNetClientList (screen_info, display_info->atoms[NET_CLIENT_LIST], screen_info->windows);
-    clientSetNetClientList (screen_info, display_info->atoms[NET_CLIENT_LIST_STACKING], screen_info->windows_stack);
+    clientQueueNetClientList (screen_info);
 
     FLAG_UNSET (c->xfwm_flags, XFWM_FLAG_MANAGED);
 }
@@ -645,6 +823,41 @@ clientGetStackList (ScreenInfo *screen_info)
     return NULL;
 }
 
+static gint
+clientCompareStackPosition (gconstpointer a, gconstpointer b)
+{
+    guint pa, pb;
+
+    pa = ((Client *) a)->stack_position;
+    pb = ((Client *) b)->stack_position;
+
+    return (pa < pb) ? -1 : ((pa > pb) ? 1 : 0);
+}
+
+/*
+ * Sorts the given clients from the bottom to the top of the stack. The
+ * positions are only walked again after the stack has changed.
+ */
+GList *
+clientSortStackList (ScreenInfo *screen_info, GList *list)
+{
+    GList *index;
+    guint position;
+
+    g_return_val_if_fail (screen_info, list);
+
+    if (!screen_info->stack_positions_valid)
+    {
+        for (index = screen_info->windows_stack, position = 0; index; index = g_list_next (index))
+        {
+            ((Client *) index->data)->stack_position = position++;
+        }
+        screen_info->stack_positions_valid = TRUE;
+    }
+
+    return g_list_sort (list, clientCompareStackPosition);
+}
+
 void
 clientSetLastRaise (Client *c)
 {
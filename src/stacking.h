@@ -55,6 +55,8 @@ gboolean                 clientAdjustFullscreenLayer            (Client *,
 void                     clientAddToList                        (Client *);
 void                     clientRemoveFromList                   (Client *);
 GList                   *clientGetStackList                     (ScreenInfo *);
+GList                   *clientSortStackList                    (ScreenInfo *,
+                                                                 GList *);
 void                     clientSetLastRaise                     (Client *);
 Client                  *clientGetLastRaise                     (ScreenInfo *);
 void                     clientClearLastRaise                   (ScreenInfo *);
@@ -44,6 +44,11 @@
 #define WIN_MAX_RATIO 0.80
 #endif
 
+/* Time spent fetching previews per main loop iteration */
+#ifndef WIN_PREVIEW_BUDGET
+#define WIN_PREVIEW_BUDGET 8000 /* usec */
+#endif
+
 #include <math.h>
 #include <glib.h>
 #include <gdk/gdk.h>
@@ -311,6 +316,7 @@ static GtkWidget *
 createWindowIcon (GdkScreen *screen, GdkPixbuf *icon_pixbuf, gint size)
 {
     GtkIconTheme *icon_theme;
+    GtkWidget *icon;
 
     TRACE ("entering");
 
@@ -319,7 +325,13 @@ createWindowIcon (GdkScreen *screen, GdkPixbuf *icon_pixbuf, gint size)
         icon_theme = gtk_icon_theme_get_for_screen (screen);
         icon_pixbuf = gtk_icon_theme_load_icon (icon_theme, "xfwm4-default", size, 0, NULL);
     }
-    return gtk_image_new_from_pixbuf (icon_pixbuf);
+    icon = gtk_image_new_from_pixbuf (icon_pixbuf);
+    if (icon_pixbuf)
+    {
+        g_object_unref (icon_pixbuf);
+    }
+
+    return icon;
 }
 
 static int
@@ -434,115 +446,178 @@ cb_window_button_leave (GtkWidget *widget, GdkEvent *event, gpointer user_data)
 }
 
 static GtkWidget *
-createWindowlist (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
+createWindowButton (ScreenInfo *screen_info, TabwinWidget *tabwin_widget, Client *c)
+{
+    Tabwin *tabwin;
+    GtkWidget *window_button;
+    GtkWidget *buttonbox;
+    GtkWidget *buttonlabel;
+    GtkWidget *icon;
+
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+    tabwin = tabwin_widget->tabwin;
+
+    window_button = gtk_button_new ();
+    gtk_button_set_relief (GTK_BUTTON (window_button), GTK_RELIEF_NONE);
+    g_object_set_data (G_OBJECT (window_button), "client-ptr-val", c);
+    g_signal_connect (window_button, "enter-notify-event",
+                      G_CALLBACK (cb_window_button_enter), tabwin_widget);
+    g_signal_connect (window_button, "leave-notify-event",
+                      G_CALLBACK (cb_window_button_leave), tabwin_widget);
+    gtk_widget_add_events (window_button, GDK_ENTER_NOTIFY_MASK);
+
+    /* Previews come later, see update_preview_idle_cb() */
+    icon = createWindowIcon (screen_info->gscr,
+                             getCachedAppIcon (c, tabwin->icon_size, tabwin->icon_size),
+                             tabwin->icon_size);
+    g_object_set_data (G_OBJECT (window_button), "icon-ptr-val", icon);
+    if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
+    {
+        buttonbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+        buttonlabel = gtk_label_new ("");
+        gtk_label_set_xalign (GTK_LABEL (buttonlabel), 0.5);
+        gtk_label_set_yalign (GTK_LABEL (buttonlabel), 1.0);
+
+        gtk_widget_set_halign (icon, GTK_ALIGN_CENTER);
+        gtk_widget_set_valign (icon, GTK_ALIGN_END);
+        gtk_box_pack_start (GTK_BOX (buttonbox), icon, TRUE, TRUE, 0);
+    }
+    else
+    {
+        buttonbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        buttonlabel = gtk_label_new (c->name);
+        gtk_label_set_xalign (GTK_LABEL (buttonlabel), 0);
+        gtk_label_set_yalign (GTK_LABEL (buttonlabel), 0.5);
+
+        gtk_widget_set_halign (icon, GTK_ALIGN_CENTER);
+        gtk_widget_set_valign (icon, GTK_ALIGN_CENTER);
+        gtk_box_pack_start (GTK_BOX (buttonbox), icon, FALSE, FALSE, 0);
+    }
+    gtk_container_add (GTK_CONTAINER (window_button), buttonbox);
+
+    gtk_label_set_justify (GTK_LABEL (buttonlabel), GTK_JUSTIFY_CENTER);
+    gtk_label_set_ellipsize (GTK_LABEL (buttonlabel), PANGO_ELLIPSIZE_END);
+    gtk_box_pack_start (GTK_BOX (buttonbox), buttonlabel, TRUE, TRUE, 0);
+    g_object_set_data (G_OBJECT (window_button), "label-ptr-val", buttonlabel);
+
+    gtk_widget_show_all (window_button);
+
+    return window_button;
+}
+
+static void
+freeWindowButton (gpointer data)
+{
+    gtk_widget_destroy (GTK_WIDGET (data));
+    g_object_unref (data);
+}
+
+static void
+setWindowButtonSize (ScreenInfo *screen_info, Tabwin *tabwin, GtkWidget *window_button)
+{
+    gint size_request;
+    gint label_width;
+
+    if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
+    {
+        size_request = tabwin->icon_size + tabwin->label_height + 2 * WIN_ICON_BORDER;
+        gtk_widget_set_size_request (window_button, size_request, size_request);
+    }
+    else
+    {
+        label_width = tabwin->monitor_width / (tabwin->grid_cols + 1);
+        gtk_widget_set_size_request (window_button, label_width,
+                                     MAX (tabwin->icon_size, tabwin->label_height) + 8);
+    }
+}
+
+static void
+clearWindowlist (TabwinWidget *tabwin_widget)
+{
+    g_list_free (tabwin_widget->widgets);
+    tabwin_widget->widgets = NULL;
+    tabwin_widget->selected = NULL;
+    tabwin_widget->hovered = NULL;
+    /* Destroying the buttons takes them out of the grid */
+    g_hash_table_remove_all (tabwin_widget->buttons);
+}
+
+/*
+ * Lays out the buttons for the clients of this cycle, buttons are only
+ * created for the clients that had none or whose title or icon changed.
+ */
+static void
+fillWindowlist (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
 {
     Client *c;
     GList *client_list;
-    GList *icon_list;
+    GList *widgets;
     GtkWidget *windowlist;
-    GtkWidget *icon;
     GtkWidget *selected;
     GtkWidget *window_button;
-    GtkWidget *buttonbox;
     GtkWidget *buttonlabel;
     GtkWidget *selected_label;
-    GdkPixbuf *icon_pixbuf;
     gint packpos;
-    gint label_width;
-    gint size_request;
     Tabwin *tabwin;
 
     TRACE ("entering");
-    g_return_val_if_fail (tabwin_widget != NULL, NULL);
+    g_return_if_fail (tabwin_widget != NULL);
     tabwin = tabwin_widget->tabwin;
-    g_return_val_if_fail (tabwin->client_count > 0, NULL);
+    windowlist = tabwin_widget->container;
 
-    packpos = 0;
-    c = NULL;
-    selected = NULL;
+    /* The buttons of the previous cycle stay in the buttons table */
+    for (widgets = tabwin_widget->widgets; widgets; widgets = g_list_next (widgets))
+    {
+        gtk_container_remove (GTK_CONTAINER (windowlist), GTK_WIDGET (widgets->data));
+    }
+    g_list_free (tabwin_widget->widgets);
     tabwin_widget->widgets = NULL;
-    size_request = tabwin->icon_size + tabwin->label_height + 2 * WIN_ICON_BORDER;
+    tabwin_widget->selected = NULL;
+    tabwin_widget->hovered = NULL;
 
-    windowlist = gtk_grid_new ();
-    gtk_grid_set_row_homogeneous (GTK_GRID (windowlist), TRUE);
-    gtk_grid_set_row_spacing (GTK_GRID (windowlist), 4);
-    gtk_grid_set_column_homogeneous (GTK_GRID (windowlist), TRUE);
-    gtk_grid_set_column_spacing (GTK_GRID (windowlist), 4);
+    packpos = 0;
+    selected = NULL;
+    selected_label = NULL;
 
-    /* pack the client icons */
-    icon_list = tabwin->icon_list;
     for (client_list = *tabwin->client_list; client_list; client_list = g_list_next (client_list))
     {
         c = (Client *) client_list->data;
-        TRACE ("adding \"%s\" (0x%lx)", c->name, c->window);
-        icon_pixbuf = (GdkPixbuf *) icon_list->data;
-        icon_list = g_list_next (icon_list);
-
-        window_button = gtk_button_new ();
-        gtk_button_set_relief (GTK_BUTTON (window_button), GTK_RELIEF_NONE);
-        g_object_set_data (G_OBJECT (window_button), "client-ptr-val", c);
-        g_signal_connect (window_button, "enter-notify-event",
-                          G_CALLBACK (cb_window_button_enter), tabwin_widget);
-        g_signal_connect (window_button, "leave-notify-event",
-                          G_CALLBACK (cb_window_button_leave), tabwin_widget);
-        gtk_widget_add_events (window_button, GDK_ENTER_NOTIFY_MASK);
-
-        icon = createWindowIcon (screen_info->gscr, icon_pixbuf, tabwin->icon_size);
-        if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
+
+        window_button = g_hash_table_lookup (tabwin_widget->buttons, c);
+        if ((window_button) && (g_object_get_data (G_OBJECT (window_button), "stale")))
         {
-            gtk_widget_set_size_request (GTK_WIDGET (window_button), size_request, size_request);
-            buttonbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
-            buttonlabel = gtk_label_new ("");
-            gtk_label_set_xalign (GTK_LABEL (buttonlabel), 0.5);
-            gtk_label_set_yalign (GTK_LABEL (buttonlabel), 1.0);
-
-            gtk_widget_set_halign (icon, GTK_ALIGN_CENTER);
-            gtk_widget_set_valign (icon, GTK_ALIGN_END);
-            gtk_box_pack_start (GTK_BOX (buttonbox), icon, TRUE, TRUE, 0);
+            g_hash_table_remove (tabwin_widget->buttons, c);
+            window_button = NULL;
+        }
+        if (window_button)
+        {
+            TRACE ("reusing \"%s\" (0x%lx)", c->name, c->window);
         }
         else
         {
-            label_width = tabwin->monitor_width / (tabwin->grid_cols + 1);
-
-            if (tabwin->icon_size < tabwin->label_height)
-            {
-                gtk_widget_set_size_request (GTK_WIDGET (window_button),
-                                             label_width, tabwin->label_height + 8);
-            }
-            else
-            {
-                gtk_widget_set_size_request (GTK_WIDGET (window_button),
-                                             label_width, tabwin->icon_size + 8);
-            }
-            buttonbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
-            buttonlabel = gtk_label_new (c->name);
-            gtk_label_set_xalign (GTK_LABEL (buttonlabel), 0);
-            gtk_label_set_yalign (GTK_LABEL (buttonlabel), 0.5);
-
-            gtk_widget_set_halign (icon, GTK_ALIGN_CENTER);
-            gtk_widget_set_valign (icon, GTK_ALIGN_CENTER);
-            gtk_box_pack_start (GTK_BOX (buttonbox), icon, FALSE, FALSE, 0);
+            TRACE ("adding \"%s\" (0x%lx)", c->name, c->window);
+            window_button = createWindowButton (screen_info, tabwin_widget, c);
+            g_hash_table_insert (tabwin_widget->buttons, c, g_object_ref_sink (window_button));
         }
-        gtk_container_add (GTK_CONTAINER (window_button), buttonbox);
-
-        gtk_label_set_justify (GTK_LABEL (buttonlabel), GTK_JUSTIFY_CENTER);
-        gtk_label_set_ellipsize (GTK_LABEL (buttonlabel), PANGO_ELLIPSIZE_END);
-        gtk_box_pack_start (GTK_BOX (buttonbox), buttonlabel, TRUE, TRUE, 0);
 
+        buttonlabel = g_object_get_data (G_OBJECT (window_button), "label-ptr-val");
         if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
         {
-            gtk_grid_attach (GTK_GRID (windowlist), GTK_WIDGET (window_button),
+            gtk_label_set_text (GTK_LABEL (buttonlabel), "");
+            gtk_grid_attach (GTK_GRID (windowlist), window_button,
                              packpos % tabwin->grid_cols, packpos / tabwin->grid_cols,
                              1, 1);
         }
         else
         {
-            gtk_grid_attach (GTK_GRID (windowlist), GTK_WIDGET (window_button),
+            gtk_grid_attach (GTK_GRID (windowlist), window_button,
                              packpos / tabwin->grid_rows, packpos % tabwin->grid_rows,
                              1, 1);
         }
+        setWindowButtonSize (screen_info, tabwin, window_button);
+        gtk_widget_unset_state_flags (window_button, GTK_STATE_FLAG_ACTIVE);
 
-        tabwin_widget->widgets = g_list_append (tabwin_widget->widgets, window_button);
+        tabwin_widget->widgets = g_list_prepend (tabwin_widget->widgets, window_button);
         packpos++;
         if (c == tabwin->selected->data)
         {
@@ -551,11 +626,12 @@ createWindowlist (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
             gtk_widget_grab_focus (selected);
         }
     }
+    tabwin_widget->widgets = g_list_reverse (tabwin_widget->widgets);
+
     if (selected)
     {
         tabwinSetSelected (tabwin_widget, selected, selected_label);
     }
-    return windowlist;
 }
 
 static gboolean
@@ -616,9 +692,7 @@ static void
 computeTabwinData (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
 {
     Tabwin *tabwin;
-    GdkPixbuf *icon_pixbuf;
     PangoLayout *layout;
-    GList *client_list;
     gint size_request;
     gint standard_icon_size;
     gboolean preview;
@@ -634,10 +708,14 @@ computeTabwinData (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
     preview = screen_info->params->cycle_preview && compositorIsActive (screen_info);
 
     /* We need to account for changes to the font size in the user's
-     * appearance theme and gtkrc settings */
-    layout = gtk_widget_create_pango_layout (GTK_WIDGET (tabwin_widget), "");
-    pango_layout_get_pixel_size (layout, NULL, &tabwin->label_height);
-    g_object_unref (layout);
+     * appearance theme and gtkrc settings, see cb_tabwin_style_updated() */
+    if (tabwin->font_height < 0)
+    {
+        layout = gtk_widget_create_pango_layout (GTK_WIDGET (tabwin_widget), "");
+        pango_layout_get_pixel_size (layout, NULL, &tabwin->font_height);
+        g_object_unref (layout);
+    }
+    tabwin->label_height = tabwin->font_height;
 
     if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
     {
@@ -669,7 +747,7 @@ computeTabwinData (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
             tabwin->icon_size = tabwin->icon_size / 2;
             if (preview && tabwin->icon_size <= standard_icon_size)
             {
-                /* Disable preview otherwise it'd be too slow */
+                /* Previews no larger than the icons are not worth it */
                 preview = FALSE;
                 /* switch back to regular icon size */
                 tabwin->icon_size = standard_icon_size;
@@ -699,33 +777,77 @@ computeTabwinData (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
                                           (double) (tabwin->icon_size + 2 * WIN_ICON_BORDER)));
         tabwin->grid_cols = (int) (ceil ((double) tabwin->client_count /
                                          (double) tabwin->grid_rows));
+        preview = FALSE;
     }
 
-    /* pack the client icons */
-    for (client_list = *tabwin->client_list; client_list; client_list = g_list_next (client_list))
+    tabwin->preview = preview;
+}
+
+static void
+cb_tabwin_style_updated (GtkWidget *widget, gpointer user_data)
+{
+    Tabwin *tabwin = user_data;
+
+    TRACE ("entering");
+
+    /* Measure the font again on next use */
+    tabwin->font_height = -1;
+}
+
+static void
+tabwinDestroyWidgets (Tabwin *tabwin)
+{
+    GList *tabwin_list;
+    TabwinWidget *tabwin_widget;
+
+    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
+        g_list_free (tabwin_widget->widgets);
+        tabwin_widget->widgets = NULL;
+        g_hash_table_destroy (tabwin_widget->buttons);
+        gtk_widget_destroy (GTK_WIDGET (tabwin_widget));
+    }
+    g_list_free (tabwin->tabwin_list);
+    tabwin->tabwin_list = NULL;
+}
+
+/* Whether the widgets kept from the previous cycle can be shown again */
+static gboolean
+tabwinWidgetsValid (Tabwin *tabwin, ScreenInfo *screen_info)
+{
+    GList *tabwin_list;
+    TabwinWidget *tabwin_widget;
+    GdkRectangle monitor;
+    int num_monitors, i;
+
+    if ((tabwin->mode != screen_info->params->cycle_tabwin_mode) ||
+        (tabwin->composited != gdk_screen_is_composited (screen_info->gscr)))
     {
-        Client *c = (Client *) client_list->data;
+        return FALSE;
+    }
 
-        if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
+    num_monitors = myScreenGetNumMonitors (screen_info);
+    if ((guint) num_monitors != g_list_length (tabwin->tabwin_list))
+    {
+        return FALSE;
+    }
+
+    for (tabwin_list = tabwin->tabwin_list, i = 0; tabwin_list; tabwin_list = g_list_next (tabwin_list), i++)
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
+        if (tabwin_widget->monitor_num != myScreenGetMonitorIndex (screen_info, i))
         {
-            if (preview)
-            {
-                icon_pixbuf = getClientIcon (c, tabwin->icon_size, tabwin->icon_size);
-            }
-            else
-            {
-                icon_pixbuf = getAppIcon (c->screen_info, c->window,
-                                          tabwin->icon_size, tabwin->icon_size);
-            }
+            return FALSE;
         }
-        else
+        xfwm_get_monitor_geometry (screen_info->gscr, tabwin_widget->monitor_num, &monitor);
+        if (!gdk_rectangle_equal (&monitor, &tabwin_widget->monitor))
         {
-            /* No preview in list mode */
-            icon_pixbuf = getAppIcon (c->screen_info, c->window,
-                                      tabwin->icon_size, tabwin->icon_size);
+            return FALSE;
         }
-        tabwin->icon_list = g_list_append(tabwin->icon_list, icon_pixbuf);
     }
+
+    return TRUE;
 }
 
 static TabwinWidget *
@@ -769,10 +891,6 @@ tabwinCreateWidget (Tabwin *tabwin, ScreenInfo *screen_info, gint monitor_num)
     gtk_widget_set_app_paintable (GTK_WIDGET (tabwin_widget), TRUE);
     gtk_widget_realize (GTK_WIDGET (tabwin_widget));
 
-    if (tabwin->icon_list == NULL)
-    {
-        computeTabwinData (screen_info, tabwin_widget);
-    }
     ctx = gtk_widget_get_style_context (GTK_WIDGET (tabwin_widget));
     gtk_style_context_get (ctx, GTK_STATE_FLAG_NORMAL,
                            GTK_STYLE_PROPERTY_BORDER_RADIUS, &border_radius,
@@ -785,6 +903,7 @@ tabwinCreateWidget (Tabwin *tabwin, ScreenInfo *screen_info, gint monitor_num)
                                     MAX (padding.left, MAX (padding.top, (MAX (padding.right, padding.bottom)))));
     gtk_window_set_position (GTK_WINDOW (tabwin_widget), GTK_WIN_POS_NONE);
     xfwm_get_monitor_geometry (screen_info->gscr, tabwin_widget->monitor_num, &monitor);
+    tabwin_widget->monitor = monitor;
     gtk_window_move (GTK_WINDOW (tabwin_widget), monitor.x + monitor.width / 2,
                                       monitor.y + monitor.height / 2);
 
@@ -800,8 +919,15 @@ tabwinCreateWidget (Tabwin *tabwin, ScreenInfo *screen_info, gint monitor_num)
         gtk_box_pack_end (GTK_BOX (vbox), tabwin_widget->label, TRUE, TRUE, 0);
     }
 
-    windowlist = createWindowlist (screen_info, tabwin_widget);
+    windowlist = gtk_grid_new ();
+    gtk_grid_set_row_homogeneous (GTK_GRID (windowlist), TRUE);
+    gtk_grid_set_row_spacing (GTK_GRID (windowlist), 4);
+    gtk_grid_set_column_homogeneous (GTK_GRID (windowlist), TRUE);
+    gtk_grid_set_column_spacing (GTK_GRID (windowlist), 4);
     tabwin_widget->container = windowlist;
+    tabwin_widget->widgets = NULL;
+    tabwin_widget->buttons = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                    NULL, freeWindowButton);
     gtk_box_pack_start (GTK_BOX (vbox), windowlist, TRUE, TRUE, 0);
 
     g_signal_connect_swapped (tabwin_widget, "configure-event",
@@ -812,7 +938,9 @@ tabwinCreateWidget (Tabwin *tabwin, ScreenInfo *screen_info, gint monitor_num)
                       G_CALLBACK (tabwin_draw),
                       (gpointer) tabwin_widget);
 
-    gtk_widget_show_all (GTK_WIDGET (tabwin_widget));
+    g_signal_connect (tabwin_widget, "style-updated",
+                      G_CALLBACK (cb_tabwin_style_updated),
+                      (gpointer) tabwin);
 
     return tabwin_widget;
 }
@@ -865,6 +993,110 @@ tabwinChange2Selected (Tabwin *tabwin, GList *selected)
     return tabwinGetSelected (tabwin);
 }
 
+static void
+setPreview (Tabwin *tabwin, Client *c, cairo_surface_t *preview)
+{
+    GList *tabwin_list;
+    TabwinWidget *tabwin_widget;
+    GtkWidget *window_button;
+    GtkWidget *icon;
+
+    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
+        window_button = g_hash_table_lookup (tabwin_widget->buttons, c);
+        if (window_button)
+        {
+            icon = g_object_get_data (G_OBJECT (window_button), "icon-ptr-val");
+            gtk_image_set_from_surface (GTK_IMAGE (icon), preview);
+        }
+    }
+}
+
+static gboolean
+update_preview_idle_cb (gpointer data)
+{
+    Tabwin *tabwin;
+    Client *c;
+    cairo_surface_t *preview;
+    gint64 deadline;
+
+    tabwin = (Tabwin *) data;
+    g_return_val_if_fail (tabwin, FALSE);
+    TRACE ("%i previews queued", g_list_length (tabwin->preview_queue));
+
+    deadline = g_get_monotonic_time () + WIN_PREVIEW_BUDGET;
+    while (tabwin->preview_queue)
+    {
+        c = (Client *) tabwin->preview_queue->data;
+        tabwin->preview_queue = g_list_delete_link (tabwin->preview_queue, tabwin->preview_queue);
+
+        preview = getClientPreview (c, tabwin->icon_size, tabwin->icon_size);
+        if (preview)
+        {
+            setPreview (tabwin, c, preview);
+            cairo_surface_destroy (preview);
+        }
+        if (g_get_monotonic_time () >= deadline)
+        {
+            break;
+        }
+    }
+
+    if (tabwin->preview_queue)
+    {
+        return (TRUE);
+    }
+    tabwin->preview_id = 0;
+
+    return (FALSE);
+}
+
+/*
+ * Previews need a server side scale and a round trip each, so they are
+ * fetched after the switcher shows, the selected window first and then
+ * in focus order.
+ */
+static void
+queuePreviews (Tabwin *tabwin)
+{
+    GList *client_list;
+
+    g_list_free (tabwin->preview_queue);
+    tabwin->preview_queue = NULL;
+
+    for (client_list = *tabwin->client_list; client_list; client_list = g_list_next (client_list))
+    {
+        if (client_list != tabwin->selected)
+        {
+            tabwin->preview_queue = g_list_prepend (tabwin->preview_queue, client_list->data);
+        }
+    }
+    tabwin->preview_queue = g_list_reverse (tabwin->preview_queue);
+    tabwin->preview_queue = g_list_prepend (tabwin->preview_queue, tabwin->selected->data);
+
+    if (tabwin->preview_id == 0)
+    {
+        tabwin->preview_id = g_idle_add (update_preview_idle_cb, tabwin);
+    }
+}
+
+static void
+clearPreviews (Tabwin *tabwin)
+{
+    if (tabwin->preview_id)
+    {
+        g_source_remove (tabwin->preview_id);
+        tabwin->preview_id = 0;
+    }
+    g_list_free (tabwin->preview_queue);
+    tabwin->preview_queue = NULL;
+}
+
+/*
+ * The switcher is kept per screen, hidden between cycles, so that showing
+ * it again only needs to lay out the buttons already built.
+ */
 Tabwin *
 tabwinCreate (GList **client_list, GList *selected, gboolean display_workspace)
 {
@@ -872,6 +1104,7 @@ tabwinCreate (GList **client_list, GList *selected, gboolean display_workspace)
     Client *c;
     Tabwin *tabwin;
     TabwinWidget *win;
+    GList *tabwin_list;
     int num_monitors, i;
 
     g_return_val_if_fail (selected, NULL);
@@ -881,23 +1114,67 @@ tabwinCreate (GList **client_list, GList *selected, gboolean display_workspace)
     c = (Client *) selected->data;
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
-    tabwin = g_new0 (Tabwin, 1);
     screen_info = c->screen_info;
+    tabwin = screen_info->tabwin;
+    if (tabwin == NULL)
+    {
+        tabwin = g_new0 (Tabwin, 1);
+        tabwin->font_height = -1;
+        screen_info->tabwin = tabwin;
+    }
+    else if (!tabwinWidgetsValid (tabwin, screen_info))
+    {
+        TRACE ("monitors or settings changed, rebuilding");
+        tabwinDestroyWidgets (tabwin);
+    }
     tabwin->display_workspace = display_workspace;
     tabwin->client_list = client_list;
     tabwin->client_count = g_list_length (*client_list);
     tabwin->selected = selected;
-    tabwin->tabwin_list = NULL;
-    tabwin->icon_list = NULL;
 
-    num_monitors = myScreenGetNumMonitors (screen_info);
-    for (i = 0; i < num_monitors; i++)
+    if (tabwin->tabwin_list == NULL)
     {
-        gint monitor_index;
+        tabwin->mode = screen_info->params->cycle_tabwin_mode;
+        tabwin->composited = gdk_screen_is_composited (screen_info->gscr);
+        tabwin->button_icon_size = -1;
 
-        monitor_index = myScreenGetMonitorIndex (screen_info, i);
-        win = tabwinCreateWidget (tabwin, screen_info, monitor_index);
-        tabwin->tabwin_list  = g_list_append (tabwin->tabwin_list, win);
+        num_monitors = myScreenGetNumMonitors (screen_info);
+        for (i = 0; i < num_monitors; i++)
+        {
+            gint monitor_index;
+
+            monitor_index = myScreenGetMonitorIndex (screen_info, i);
+            win = tabwinCreateWidget (tabwin, screen_info, monitor_index);
+            tabwin->tabwin_list = g_list_append (tabwin->tabwin_list, win);
+        }
+    }
+
+    computeTabwinData (screen_info, (TabwinWidget *) tabwin->tabwin_list->data);
+    if ((tabwin->icon_size != tabwin->button_icon_size) ||
+        (tabwin->preview != tabwin->button_preview))
+    {
+        /* Icons of the wrong size, start over */
+        for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+        {
+            win = (TabwinWidget *) tabwin_list->data;
+            clearWindowlist (win);
+        }
+        tabwin->button_icon_size = tabwin->icon_size;
+        tabwin->button_preview = tabwin->preview;
+    }
+
+    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        win = (TabwinWidget *) tabwin_list->data;
+        fillWindowlist (screen_info, win);
+        /* Shrink to the new contents, tabwinConfigure() centers it */
+        gtk_window_resize (GTK_WINDOW (win), 1, 1);
+        gtk_widget_show_all (GTK_WIDGET (win));
+    }
+
+    if (tabwin->preview)
+    {
+        queuePreviews (tabwin);
     }
 
     return tabwin;
@@ -947,7 +1224,9 @@ tabwinRemoveClient (Tabwin *tabwin, Client *c)
         }
     }
 
-    /* Second, remove the icon from all boxes */
+    tabwin->preview_queue = g_list_remove (tabwin->preview_queue, c);
+
+    /* Second, remove the icon from all boxes, the button is kept for later */
     for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
     {
         tabwin_widget = (TabwinWidget *) tabwin_list->data;
@@ -958,6 +1237,7 @@ tabwinRemoveClient (Tabwin *tabwin, Client *c)
             {
                 gtk_container_remove (GTK_CONTAINER (tabwin_widget->container), icon);
                 tabwin_widget->widgets = g_list_delete_link (tabwin_widget->widgets, widgets);
+                break;
             }
         }
     }
@@ -1275,12 +1555,97 @@ tabwinDestroy (Tabwin *tabwin)
     g_return_if_fail (tabwin != NULL);
     TRACE ("entering");
 
+    clearPreviews (tabwin);
+
+    /* Keep everything for the next cycle, see tabwinClose() */
     for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
     {
         tabwin_widget = (TabwinWidget *) tabwin_list->data;
-        g_list_free (tabwin_widget->widgets);
-        gtk_widget_destroy (GTK_WIDGET (tabwin_widget));
+        gtk_widget_hide (GTK_WIDGET (tabwin_widget));
+        tabwin_widget->hovered = NULL;
     }
-    g_list_free_full (tabwin->icon_list, g_object_unref);
-    g_list_free (tabwin->tabwin_list);
+    tabwin->client_list = NULL;
+    tabwin->selected = NULL;
+}
+
+/* The title or the icon of the client changed */
+void
+tabwinUpdateClient (Client *c)
+{
+    GList *tabwin_list;
+    TabwinWidget *tabwin_widget;
+    GtkWidget *window_button;
+
+    g_return_if_fail (c != NULL);
+
+    if (c->screen_info->tabwin == NULL)
+    {
+        return;
+    }
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    /* Not rebuilt right away as the switcher may be showing it */
+    for (tabwin_list = c->screen_info->tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
+        window_button = g_hash_table_lookup (tabwin_widget->buttons, c);
+        if (window_button)
+        {
+            g_object_set_data (G_OBJECT (window_button), "stale", GINT_TO_POINTER (TRUE));
+        }
+    }
+}
+
+void
+tabwinForgetClient (Client *c)
+{
+    GList *tabwin_list;
+    TabwinWidget *tabwin_widget;
+    GtkWidget *window_button;
+
+    g_return_if_fail (c != NULL);
+
+    if (c->screen_info->tabwin == NULL)
+    {
+        return;
+    }
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    c->screen_info->tabwin->preview_queue =
+        g_list_remove (c->screen_info->tabwin->preview_queue, c);
+
+    for (tabwin_list = c->screen_info->tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
+        window_button = g_hash_table_lookup (tabwin_widget->buttons, c);
+        if (window_button)
+        {
+            if (tabwin_widget->selected == window_button)
+            {
+                tabwin_widget->selected = NULL;
+            }
+            if (tabwin_widget->hovered == window_button)
+            {
+                tabwin_widget->hovered = NULL;
+            }
+            tabwin_widget->widgets = g_list_remove (tabwin_widget->widgets, window_button);
+            g_hash_table_remove (tabwin_widget->buttons, c);
+        }
+    }
+}
+
+void
+tabwinClose (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+    TRACE ("entering");
+
+    if (screen_info->tabwin == NULL)
+    {
+        return;
+    }
+    clearPreviews (screen_info->tabwin);
+    tabwinDestroyWidgets (screen_info->tabwin);
+    g_free (screen_info->tabwin);
+    screen_info->tabwin = NULL;
 }
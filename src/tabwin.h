@@ -31,7 +31,6 @@
 #include <gdk/gdk.h>
 #include <gtk/gtk.h>
 
-typedef struct _Tabwin Tabwin;
 typedef struct _TabwinWidget TabwinWidget;
 typedef struct _TabwinWidgetClass TabwinWidgetClass;
 
@@ -46,7 +45,6 @@ struct _Tabwin
 {
     GList *tabwin_list;
     GList **client_list;
-    GList *icon_list;
     GList *selected;
     gint monitor_width;
     gint monitor_height;
@@ -56,6 +54,17 @@ struct _Tabwin
     gint icon_size;
     gint label_height;
     gboolean display_workspace;
+    gboolean preview;
+    /* Clients whose preview is still to be fetched */
+    GList *preview_queue;
+    guint preview_id;
+
+    /* What the widgets were built for, checked by tabwinCreate() */
+    gint mode;
+    gboolean composited;
+    gint font_height;
+    gint button_icon_size;
+    gboolean button_preview;
 };
 
 struct _TabwinWidget
@@ -63,6 +72,8 @@ struct _TabwinWidget
     GtkWindow __parent__;
     /* The below must be freed when destroying */
     GList *widgets;
+    /* Client * to window button, kept across cycles */
+    GHashTable *buttons;
 
     /* these don't have to be */
     Tabwin *tabwin;
@@ -75,6 +86,7 @@ struct _TabwinWidget
     gint width;
     gint height;
     gint monitor_num;
+    GdkRectangle monitor;
 };
 
 struct _TabwinWidgetClass
@@ -94,5 +106,8 @@ Client                  *tabwinSelectHovered                    (Tabwin *);
 Client                  *tabwinRemoveClient                     (Tabwin *,
                                                                  Client *);
 void                    tabwinDestroy                           (Tabwin *);
+void                    tabwinUpdateClient                      (Client *);
+void                    tabwinForgetClient                      (Client *);
+void                    tabwinClose                             (ScreenInfo *);
 
 #endif /* INC_TABWIN_H */
@@ -0,0 +1,489 @@
+/*      $Id$
+
+        This program is free software; you can redistribute it and/or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2, or (at your option)
+        any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program; if not, write to the Free Software
+        Foundation, Inc., Inc., 51 Franklin Street, Fifth Floor, Boston,
+        MA 02110-1301, USA.
+
+
+        xfwm4    - (c) 2002-2015 Olivier Fourdan
+
+ */
+
+/*
+ * Compiled theme cache.
+ *
+ * Decoding the XPM parts and probing for the other image formats is by
+ * far the slowest part of loading a theme, so the decoded parts are kept
+ * in $XDG_CACHE_HOME/xfwm4 as premultiplied cairo image data, one file
+ * per theme directory, and mapped back in on the next load.
+ *
+ * The cache is only used if its signature matches, the signature covers
+ * the theme directory, the name, size and mtime of every file in it and
+ * the color symbols substituted in the XPM files.
+ *
+ * Each screen keeps a reference on the cache of its current theme, so
+ * that other screens using the same theme and colors, as well as theme
+ * reloads, get the already decoded parts straight from memory.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <cairo/cairo.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "mypixmap.h"
+#include "themecache.h"
+
+#define THEME_CACHE_MAGIC               0x58465443 /* "XFTC" */
+#define THEME_CACHE_VERSION             1
+#define THEME_CACHE_NAME_SIZE           32
+#define THEME_CACHE_MISSING             ((guint32) CAIRO_FORMAT_INVALID)
+#define THEME_CACHE_ALIGN(n)            (((n) + 15) & ~15)
+
+typedef struct
+{
+    guint32 magic;
+    guint32 version;
+    guint64 signature;
+    guint32 n_entries;
+    guint32 reserved;
+}
+ThemeCacheHeader;
+
+typedef struct
+{
+    gchar name[THEME_CACHE_NAME_SIZE];
+    /* A part missing from the theme has no format and no data */
+    guint32 format;
+    guint32 width;
+    guint32 height;
+    guint32 stride;
+    guint32 offset;
+    guint32 reserved;
+}
+ThemeCacheEntry;
+
+struct _ThemeCache
+{
+    gchar *filename;
+    guint64 signature;
+    guint ref_count;
+    GMappedFile *mapped;
+    const ThemeCacheHeader *header;
+    const ThemeCacheEntry *entries;
+    /* Parts known so far, NULL for the parts missing from the theme */
+    GHashTable *parts;
+    /* Parts were decoded that the file does not have */
+    gboolean dirty;
+};
+
+/* Caches in use, by file name, shared by all screens */
+static GHashTable *theme_caches = NULL;
+
+static guint64
+themeCacheHash (guint64 hash, gconstpointer data, gsize len)
+{
+    const guchar *p;
+    gsize i;
+
+    /* FNV-1a */
+    p = data;
+    for (i = 0; i < len; i++)
+    {
+        hash ^= p[i];
+        hash *= G_GUINT64_CONSTANT (0x100000001b3);
+    }
+
+    return hash;
+}
+
+static guint64
+themeCacheHashString (guint64 hash, const gchar *s)
+{
+    if (s)
+    {
+        hash = themeCacheHash (hash, s, strlen (s));
+    }
+    /* Include the terminator so that "ab" + "c" != "a" + "bc" */
+    return themeCacheHash (hash, "", 1);
+}
+
+static guint64
+themeCacheSignature (const gchar *dir, xfwmColorSymbol *cs)
+{
+    GDir *gdir;
+    GStatBuf st;
+    const gchar *name;
+    gchar *filename;
+    guint64 signature, files, hash;
+    guint32 version;
+
+    signature = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+    version = THEME_CACHE_VERSION;
+    signature = themeCacheHash (signature, &version, sizeof (version));
+    signature = themeCacheHashString (signature, dir);
+    while (cs && cs->name)
+    {
+        signature = themeCacheHashString (signature, cs->name);
+        signature = themeCacheHashString (signature, cs->value);
+        cs++;
+    }
+
+    gdir = g_dir_open (dir, 0, NULL);
+    if (!gdir)
+    {
+        return signature;
+    }
+
+    /* Summed so that the directory order does not matter */
+    files = 0;
+    while ((name = g_dir_read_name (gdir)))
+    {
+        filename = g_build_filename (dir, name, NULL);
+        if (g_stat (filename, &st) == 0)
+        {
+            hash = themeCacheHashString (G_GUINT64_CONSTANT (0xcbf29ce484222325), name);
+            hash = themeCacheHash (hash, &st.st_size, sizeof (st.st_size));
+            hash = themeCacheHash (hash, &st.st_mtime, sizeof (st.st_mtime));
+            files += hash;
+        }
+        g_free (filename);
+    }
+    g_dir_close (gdir);
+
+    return themeCacheHash (signature, &files, sizeof (files));
+}
+
+static gboolean
+themeCacheValidate (ThemeCache *cache)
+{
+    const ThemeCacheHeader *header;
+    const ThemeCacheEntry *entry;
+    gsize length;
+    guint32 i;
+
+    length = g_mapped_file_get_length (cache->mapped);
+    header = (const ThemeCacheHeader *) g_mapped_file_get_contents (cache->mapped);
+
+    if (length < sizeof (ThemeCacheHeader) ||
+        header->magic != THEME_CACHE_MAGIC ||
+        header->version != THEME_CACHE_VERSION ||
+        header->signature != cache->signature ||
+        header->n_entries > (length - sizeof (ThemeCacheHeader)) / sizeof (ThemeCacheEntry))
+    {
+        return FALSE;
+    }
+
+    entry = (const ThemeCacheEntry *) (header + 1);
+    for (i = 0; i < header->n_entries; i++, entry++)
+    {
+        if (entry->name[THEME_CACHE_NAME_SIZE - 1] != '\0')
+        {
+            return FALSE;
+        }
+        if (entry->format == THEME_CACHE_MISSING)
+        {
+            continue;
+        }
+        if ((entry->format != CAIRO_FORMAT_ARGB32 && entry->format != CAIRO_FORMAT_RGB24) ||
+            entry->width == 0 || entry->height == 0 ||
+            entry->stride < (guint32) cairo_format_stride_for_width ((cairo_format_t) entry->format, entry->width) ||
+            entry->offset % 16 ||
+            entry->offset > length ||
+            (guint64) entry->stride * entry->height > length - entry->offset)
+        {
+            return FALSE;
+        }
+    }
+
+    cache->header = header;
+    cache->entries = (const ThemeCacheEntry *) (header + 1);
+
+    return TRUE;
+}
+
+ThemeCache *
+themeCacheOpen (const gchar *dir, xfwmColorSymbol *cs)
+{
+    ThemeCache *cache;
+    gchar *checksum;
+    gchar *basename;
+    gchar *filename;
+    guint64 signature;
+
+    g_return_val_if_fail (dir != NULL, NULL);
+    TRACE ("dir %s", dir);
+
+    signature = themeCacheSignature (dir, cs);
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, dir, -1);
+    basename = g_strdup_printf ("theme-%s.cache", checksum);
+    filename = g_build_filename (g_get_user_cache_dir (), "xfwm4", basename, NULL);
+    g_free (basename);
+    g_free (checksum);
+
+    if (!theme_caches)
+    {
+        theme_caches = g_hash_table_new (g_str_hash, g_str_equal);
+    }
+
+    /* Another screen or a previous load already has it decoded */
+    cache = g_hash_table_lookup (theme_caches, filename);
+    if (cache && cache->signature == signature)
+    {
+        g_free (filename);
+        cache->ref_count++;
+        return cache;
+    }
+
+    cache = g_new0 (ThemeCache, 1);
+    cache->filename = filename;
+    cache->signature = signature;
+    cache->ref_count = 1;
+    cache->parts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify) cairo_surface_destroy);
+
+    cache->mapped = g_mapped_file_new (cache->filename, FALSE, NULL);
+    if (cache->mapped && !themeCacheValidate (cache))
+    {
+        DBG ("theme cache \"%s\" is out of date", cache->filename);
+        g_mapped_file_unref (cache->mapped);
+        cache->mapped = NULL;
+    }
+    g_hash_table_replace (theme_caches, cache->filename, cache);
+
+    return cache;
+}
+
+static gboolean
+themeCacheLookupMapped (ThemeCache *cache, const gchar *name, cairo_surface_t **surface)
+{
+    const ThemeCacheEntry *entry;
+    guchar *data;
+    guint32 i;
+
+    if (!cache->mapped)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < cache->header->n_entries; i++)
+    {
+        entry = &cache->entries[i];
+        if (strcmp (entry->name, name))
+        {
+            continue;
+        }
+        if (entry->format != THEME_CACHE_MISSING)
+        {
+            /* Only ever used as a source, the mapping is read-only */
+            data = (guchar *) g_mapped_file_get_contents (cache->mapped) + entry->offset;
+            *surface = cairo_image_surface_create_for_data (data, (cairo_format_t) entry->format,
+                                                            entry->width, entry->height,
+                                                            entry->stride);
+        }
+        g_hash_table_insert (cache->parts, g_strdup (name), *surface);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+gboolean
+themeCacheLookup (ThemeCache *cache, const gchar *name, cairo_surface_t **surface)
+{
+    gpointer value;
+
+    g_return_val_if_fail (name != NULL, FALSE);
+    g_return_val_if_fail (surface != NULL, FALSE);
+
+    *surface = NULL;
+    if (!cache)
+    {
+        return FALSE;
+    }
+
+    if (g_hash_table_lookup_extended (cache->parts, name, NULL, &value))
+    {
+        *surface = value;
+    }
+    else if (!themeCacheLookupMapped (cache, name, surface))
+    {
+        return FALSE;
+    }
+
+    if (*surface)
+    {
+        cairo_surface_reference (*surface);
+    }
+
+    return TRUE;
+}
+
+void
+themeCacheStore (ThemeCache *cache, const gchar *name, cairo_surface_t *surface)
+{
+    g_return_if_fail (name != NULL);
+
+    if (!cache || strlen (name) >= THEME_CACHE_NAME_SIZE)
+    {
+        return;
+    }
+    if (surface && cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+    {
+        return;
+    }
+    if (g_hash_table_contains (cache->parts, name))
+    {
+        return;
+    }
+
+    if (surface)
+    {
+        cairo_surface_reference (surface);
+    }
+    g_hash_table_insert (cache->parts, g_strdup (name), surface);
+    cache->dirty = TRUE;
+}
+
+static gint
+themeCacheCompareNames (gconstpointer a, gconstpointer b)
+{
+    return strcmp ((const gchar *) a, (const gchar *) b);
+}
+
+void
+themeCacheSave (ThemeCache *cache)
+{
+    ThemeCacheHeader header;
+    ThemeCacheEntry *entries;
+    cairo_surface_t *surface;
+    cairo_surface_t *unused;
+    GByteArray *buffer;
+    GError *error;
+    gchar *dirname;
+    GList *names, *list;
+    guint32 i, n, offset;
+    gint height, stride;
+
+    if (!cache || !cache->dirty)
+    {
+        return;
+    }
+
+    /* The file gets replaced, so pull in whatever it has that is not loaded yet */
+    for (i = 0; cache->mapped && i < cache->header->n_entries; i++)
+    {
+        if (!g_hash_table_contains (cache->parts, cache->entries[i].name))
+        {
+            unused = NULL;
+            themeCacheLookupMapped (cache, cache->entries[i].name, &unused);
+        }
+    }
+
+    names = g_list_sort (g_hash_table_get_keys (cache->parts), themeCacheCompareNames);
+    n = g_list_length (names);
+    entries = g_new0 (ThemeCacheEntry, n);
+
+    offset = THEME_CACHE_ALIGN (sizeof (ThemeCacheHeader) + n * sizeof (ThemeCacheEntry));
+    for (list = names, i = 0; list; list = g_list_next (list), i++)
+    {
+        surface = g_hash_table_lookup (cache->parts, list->data);
+        g_strlcpy (entries[i].name, list->data, THEME_CACHE_NAME_SIZE);
+        entries[i].format = THEME_CACHE_MISSING;
+        if (!surface)
+        {
+            continue;
+        }
+        cairo_surface_flush (surface);
+        height = cairo_image_surface_get_height (surface);
+        stride = cairo_image_surface_get_stride (surface);
+        entries[i].format = cairo_image_surface_get_format (surface);
+        entries[i].width = cairo_image_surface_get_width (surface);
+        entries[i].height = height;
+        entries[i].stride = stride;
+        entries[i].offset = offset;
+        offset = THEME_CACHE_ALIGN (offset + stride * height);
+    }
+
+    memset (&header, 0, sizeof (header));
+    header.magic = THEME_CACHE_MAGIC;
+    header.version = THEME_CACHE_VERSION;
+    header.signature = cache->signature;
+    header.n_entries = n;
+
+    buffer = g_byte_array_sized_new (offset);
+    g_byte_array_append (buffer, (const guint8 *) &header, sizeof (header));
+    g_byte_array_append (buffer, (const guint8 *) entries, n * sizeof (ThemeCacheEntry));
+    for (list = names, i = 0; list; list = g_list_next (list), i++)
+    {
+        surface = g_hash_table_lookup (cache->parts, list->data);
+        if (!surface)
+        {
+            continue;
+        }
+        g_byte_array_set_size (buffer, entries[i].offset);
+        g_byte_array_append (buffer, cairo_image_surface_get_data (surface),
+                             entries[i].stride * entries[i].height);
+    }
+    g_list_free (names);
+    g_free (entries);
+
+    error = NULL;
+    dirname = g_path_get_dirname (cache->filename);
+    if (g_mkdir_with_parents (dirname, 0700) < 0 ||
+        !g_file_set_contents (cache->filename, (const gchar *) buffer->data, buffer->len, &error))
+    {
+        DBG ("cannot write theme cache \"%s\": %s", cache->filename,
+             error ? error->message : g_strerror (errno));
+        g_clear_error (&error);
+    }
+    g_free (dirname);
+    g_byte_array_free (buffer, TRUE);
+    cache->dirty = FALSE;
+}
+
+void
+themeCacheClose (ThemeCache *cache)
+{
+    if (!cache)
+    {
+        return;
+    }
+
+    g_return_if_fail (cache->ref_count > 0);
+    if (--cache->ref_count > 0)
+    {
+        return;
+    }
+
+    if (g_hash_table_lookup (theme_caches, cache->filename) == cache)
+    {
+        g_hash_table_remove (theme_caches, cache->filename);
+    }
+    /* Surfaces may point into the mapping, drop them first */
+    g_hash_table_destroy (cache->parts);
+    if (cache->mapped)
+    {
+        g_mapped_file_unref (cache->mapped);
+    }
+    g_free (cache->filename);
+    g_free (cache);
+}
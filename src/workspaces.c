@@ -244,7 +244,7 @@ workspaceSwitch (ScreenInfo *screen_info, gint new_ws, Client * c2, gboolean upd
     DisplayInfo *display_info;
     Client *c, *new_focus;
     Client *previous;
-    GList *list;
+    GList *list, *candidates, *to_show, *to_hide;
     Window dr, window;
     gint rx, ry, wx, wy;
     unsigned int mask;
@@ -304,50 +304,91 @@ workspaceSwitch (ScreenInfo *screen_info, gint new_ws, Client * c2, gboolean upd
         }
     }
 
+    /*
+     * Work out what to show, from top to bottom, and what to hide, from
+     * bottom to top, before changing anything. Showing a window only ever
+     * brings its transients to the new workspace, so the hide set can just
+     * be checked again as it goes. The workspace index gives the windows
+     * concerned, only those are sorted back into stacking order.
+     */
+    candidates = workspaceGetClients (screen_info, new_ws);
+    candidates = g_list_concat (candidates, workspaceGetClients (screen_info, ALL_WORKSPACES));
+    candidates = clientSortStackList (screen_info, candidates);
+    to_show = NULL;
+    for (list = candidates; list; list = g_list_next (list))
+    {
+        c = (Client *) list->data;
+        if (FLAG_TEST (c->flags, CLIENT_FLAG_STICKY) ||
+            (!FLAG_TEST (c->flags, CLIENT_FLAG_ICONIFIED) && !FLAG_TEST (c->xfwm_flags, XFWM_FLAG_VISIBLE)))
+        {
+            to_show = g_list_prepend (to_show, c);
+        }
+    }
+    g_list_free (candidates);
+
+    /* Besides sticky ones, only windows on the workspace left are visible */
+    candidates = workspaceGetClients (screen_info, screen_info->previous_ws);
+    candidates = clientSortStackList (screen_info, candidates);
+    to_hide = NULL;
+    for (list = candidates; list; list = g_list_next (list))
+    {
+        c = (Client *) list->data;
+        if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_VISIBLE))
+        {
+            to_hide = g_list_prepend (to_hide, c);
+        }
+    }
+    g_list_free (candidates);
+    to_hide = g_list_reverse (to_hide);
+
+    /* Everything goes out in one burst, and the work area is updated once */
+    myDisplayGrabServer (display_info);
+    workspaceFreezeArea (screen_info);
+
     /* First pass: Show, from top to bottom */
-    for (list = g_list_last(screen_info->windows_stack); list; list = g_list_previous (list))
+    for (list = to_show; list; list = g_list_next (list))
     {
         c = (Client *) list->data;
         if (FLAG_TEST (c->flags, CLIENT_FLAG_STICKY))
         {
             clientSetWorkspace (c, new_ws, TRUE);
         }
-        else if (new_ws == (gint) c->win_workspace)
+        else if (!clientIsTransientOrModal (c) || !clientTransientOrModalHasAncestor (c, new_ws))
         {
-            if (!FLAG_TEST (c->flags, CLIENT_FLAG_ICONIFIED) && !FLAG_TEST (c->xfwm_flags, XFWM_FLAG_VISIBLE))
-            {
-                if (!clientIsTransientOrModal (c) || !clientTransientOrModalHasAncestor (c, new_ws))
-                {
-                    clientShow (c, FALSE);
-                }
-            }
+            clientShow (c, FALSE);
         }
     }
 
+    if ((previous) && (new_ws != (gint) previous->win_workspace))
+    {
+        FLAG_SET (previous->xfwm_flags, XFWM_FLAG_FOCUS);
+        clientSetFocus (screen_info, NULL, timestamp, FOCUS_IGNORE_MODAL);
+    }
+
     /* Second pass: Hide from bottom to top */
-    for (list = screen_info->windows_stack; list; list = g_list_next (list))
+    for (list = to_hide; list; list = g_list_next (list))
     {
         c = (Client *) list->data;
-
-        if (new_ws != (gint) c->win_workspace)
+        if ((new_ws != (gint) c->win_workspace) &&
+            FLAG_TEST (c->xfwm_flags, XFWM_FLAG_VISIBLE) && !FLAG_TEST (c->flags, CLIENT_FLAG_STICKY))
         {
-            if (c == previous)
+            if (!clientIsTransientOrModal (c) || !clientTransientOrModalHasAncestor (c, new_ws))
             {
-                FLAG_SET (previous->xfwm_flags, XFWM_FLAG_FOCUS);
-                clientSetFocus (screen_info, NULL, timestamp, FOCUS_IGNORE_MODAL);
-            }
-            if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_VISIBLE) && !FLAG_TEST (c->flags, CLIENT_FLAG_STICKY))
-            {
-                if (!clientIsTransientOrModal (c) || !clientTransientOrModalHasAncestor (c, new_ws))
-                {
-                    clientWithdraw (c, new_ws, FALSE);
-                }
+                clientWithdraw (c, new_ws, FALSE);
             }
         }
     }
 
+    workspaceThawArea (screen_info);
+    myDisplayUngrabServer (display_info);
+    g_list_free (to_show);
+    g_list_free (to_hide);
+
     /* Third pass: Check for focus, from top to bottom */
-    for (list = g_list_last(screen_info->windows_stack); list; list = g_list_previous (list))
+    candidates = workspaceGetClients (screen_info, new_ws);
+    candidates = g_list_concat (candidates, workspaceGetClients (screen_info, ALL_WORKSPACES));
+    candidates = clientSortStackList (screen_info, candidates);
+    for (list = g_list_last (candidates); list; list = g_list_previous (list))
     {
         c = (Client *) list->data;
 
@@ -368,6 +409,7 @@ workspaceSwitch (ScreenInfo *screen_info, gint new_ws, Client * c2, gboolean upd
             FLAG_UNSET (c->xfwm_flags, XFWM_FLAG_FOCUS);
         }
     }
+    g_list_free (candidates);
 
     setNetCurrentDesktop (display_info, screen_info->xroot, new_ws);
     if (!(screen_info->params->click_to_focus))
@@ -402,6 +444,31 @@ workspaceSwitch (ScreenInfo *screen_info, gint new_ws, Client * c2, gboolean upd
     }
 }
 
+/*
+ * Moves the clients filed under workspace "from" to workspace "to", sticky
+ * clients are filed apart and left alone.
+ */
+static void
+workspaceMoveClients (ScreenInfo *screen_info, guint from, guint to)
+{
+    Client *c;
+    GList *list_of_windows;
+    GList *list;
+
+    /* Work on a copy, clientSetWorkspace() refiles the clients as it goes */
+    list_of_windows = workspaceGetClients (screen_info, from);
+    for (list = list_of_windows; list; list = g_list_next (list))
+    {
+        c = (Client *) list->data;
+        /* Transients follow their parent, they may have been moved already */
+        if (c->win_workspace == from)
+        {
+            clientSetWorkspace (c, to, TRUE);
+        }
+    }
+    g_list_free (list_of_windows);
+}
+
 void
 workspaceSetNames (ScreenInfo * screen_info, gchar **names, int items)
 {
@@ -424,7 +491,9 @@ workspaceSetCount (ScreenInfo * screen_info, guint count)
 {
     DisplayInfo *display_info;
     Client *c;
+    GList *list_of_windows;
     GList *list;
+    guint ws, previous_count;
 
     g_return_if_fail (screen_info != NULL);
 
@@ -441,9 +510,16 @@ workspaceSetCount (ScreenInfo * screen_info, guint count)
 
     display_info = screen_info->display_info;
     setHint (display_info, screen_info->xroot, NET_NUMBER_OF_DESKTOPS, count);
+    previous_count = screen_info->workspace_count;
     screen_info->workspace_count = count;
 
-    for (list = screen_info->windows_stack; list; list = g_list_next (list))
+    /* Only the workspaces going away have windows to move */
+    for (ws = count; ws < previous_count; ws++)
+    {
+        workspaceMoveClients (screen_info, ws, count - 1);
+    }
+    list_of_windows = workspaceGetClients (screen_info, ALL_WORKSPACES);
+    for (list = list_of_windows; list; list = g_list_next (list))
     {
         c = (Client *) list->data;
         if (c->win_workspace > count - 1)
@@ -451,6 +527,7 @@ workspaceSetCount (ScreenInfo * screen_info, guint count)
             clientSetWorkspace (c, count - 1, TRUE);
         }
     }
+    g_list_free (list_of_windows);
     if (screen_info->current_ws > count - 1)
     {
         workspaceSwitch (screen_info, count - 1, NULL, TRUE, myDisplayGetCurrentTime (display_info));
@@ -466,8 +543,9 @@ void
 workspaceInsert (ScreenInfo * screen_info, guint position)
 {
     Client *c;
+    GList *list_of_windows;
     GList *list;
-    guint count;
+    guint ws, count;
 
     g_return_if_fail (screen_info != NULL);
 
@@ -481,7 +559,13 @@ workspaceInsert (ScreenInfo * screen_info, guint position)
         return;
     }
 
-    for (list = screen_info->windows_stack; list; list = g_list_next (list))
+    /* From the last workspace down, so no window gets shifted twice */
+    for (ws = count; ws-- > position;)
+    {
+        workspaceMoveClients (screen_info, ws, ws + 1);
+    }
+    list_of_windows = workspaceGetClients (screen_info, ALL_WORKSPACES);
+    for (list = list_of_windows; list; list = g_list_next (list))
     {
         c = (Client *) list->data;
         if (c->win_workspace >= position)
@@ -489,13 +573,16 @@ workspaceInsert (ScreenInfo * screen_info, guint position)
             clientSetWorkspace (c, c->win_workspace + 1, TRUE);
         }
     }
+    g_list_free (list_of_windows);
 }
 
 void
 workspaceDelete (ScreenInfo * screen_info, guint position)
 {
     Client *c;
-    guint i, count;
+    GList *list_of_windows;
+    GList *list;
+    guint ws, count;
 
     g_return_if_fail (screen_info != NULL);
 
@@ -507,27 +594,160 @@ workspaceDelete (ScreenInfo * screen_info, guint position)
         return;
     }
 
-    for (c = screen_info->clients, i = 0; i < screen_info->client_count; c = c->next, i++)
+    /* From the first workspace up, so no window gets shifted twice */
+    for (ws = position + 1; ws < count; ws++)
     {
+        workspaceMoveClients (screen_info, ws, ws - 1);
+    }
+    list_of_windows = workspaceGetClients (screen_info, ALL_WORKSPACES);
+    for (list = list_of_windows; list; list = g_list_next (list))
+    {
+        c = (Client *) list->data;
         if (c->win_workspace > position)
         {
             clientSetWorkspace (c, c->win_workspace - 1, TRUE);
         }
     }
+    g_list_free (list_of_windows);
 
     workspaceSetCount(screen_info, count - 1);
 }
 
+/*
+ * Per-workspace membership index: every managed client is filed under its
+ * workspace, or under ALL_WORKSPACES when sticky, so that the workspace
+ * operations only look at the windows they concern.
+ */
+void
+workspaceIndexInit (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+
+    screen_info->workspace_index =
+        g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_queue_free);
+}
+
+void
+workspaceIndexClose (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+
+    if (screen_info->workspace_index)
+    {
+        g_hash_table_destroy (screen_info->workspace_index);
+        screen_info->workspace_index = NULL;
+    }
+}
+
+void
+workspaceIndexRemove (Client *c)
+{
+    GQueue *queue;
+
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    if (c->workspace_link && c->screen_info->workspace_index)
+    {
+        queue = g_hash_table_lookup (c->screen_info->workspace_index,
+                                     GUINT_TO_POINTER (c->workspace_key));
+        g_queue_delete_link (queue, c->workspace_link);
+        if (g_queue_is_empty (queue))
+        {
+            g_hash_table_remove (c->screen_info->workspace_index,
+                                 GUINT_TO_POINTER (c->workspace_key));
+        }
+    }
+    c->workspace_link = NULL;
+}
+
+void
+workspaceIndexUpdate (Client *c)
+{
+    GQueue *queue;
+    guint key;
+
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    /* Only managed clients are indexed, so they get removed when unmanaged */
+    if (!c->screen_info->workspace_index || !FLAG_TEST (c->xfwm_flags, XFWM_FLAG_MANAGED))
+    {
+        return;
+    }
+
+    key = FLAG_TEST (c->flags, CLIENT_FLAG_STICKY) ? ALL_WORKSPACES : c->win_workspace;
+    if ((c->workspace_link) && (c->workspace_key == key))
+    {
+        return;
+    }
+    workspaceIndexRemove (c);
+
+    queue = g_hash_table_lookup (c->screen_info->workspace_index, GUINT_TO_POINTER (key));
+    if (queue == NULL)
+    {
+        queue = g_queue_new ();
+        g_hash_table_insert (c->screen_info->workspace_index, GUINT_TO_POINTER (key), queue);
+    }
+    g_queue_push_tail (queue, c);
+    c->workspace_link = g_queue_peek_tail_link (queue);
+    c->workspace_key = key;
+}
+
+/*
+ * Returns the clients filed under workspace "ws" (ALL_WORKSPACES for the
+ * sticky ones), in no particular order. The caller must free the list.
+ */
+GList *
+workspaceGetClients (ScreenInfo *screen_info, guint ws)
+{
+    GQueue *queue;
+
+    g_return_val_if_fail (screen_info != NULL, NULL);
+
+    if (!screen_info->workspace_index)
+    {
+        return NULL;
+    }
+    queue = g_hash_table_lookup (screen_info->workspace_index, GUINT_TO_POINTER (ws));
+
+    return (queue ? g_list_copy (queue->head) : NULL);
+}
+
+/*
+ * Holds workspaceUpdateArea() back until the matching workspaceThawArea(),
+ * for when many windows are shown or hidden at once.
+ */
+void
+workspaceFreezeArea (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+
+    screen_info->area_freeze++;
+}
+
+void
+workspaceThawArea (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+    g_return_if_fail (screen_info->area_freeze > 0);
+
+    screen_info->area_freeze--;
+    if ((screen_info->area_freeze == 0) && (screen_info->area_pending))
+    {
+        screen_info->area_pending = FALSE;
+        workspaceUpdateArea (screen_info);
+    }
+}
+
 void
 workspaceUpdateArea (ScreenInfo *screen_info)
 {
     DisplayInfo *display_info;
     Client *c;
+    GList *list;
     GdkRectangle top, left, right, bottom, workarea;
-    int prev_top;
-    int prev_left;
-    int prev_right;
-    int prev_bottom;
+    int prev_margins[4];
     guint i;
 
 
@@ -537,21 +757,25 @@ workspaceUpdateArea (ScreenInfo *screen_info)
 
     TRACE ("entering");
 
-    display_info = screen_info->display_info;
-    prev_top = screen_info->margins[STRUTS_TOP];
-    prev_left = screen_info->margins[STRUTS_LEFT];
-    prev_right = screen_info->margins[STRUTS_RIGHT];
-    prev_bottom = screen_info->margins[STRUTS_BOTTOM];
+    if (screen_info->area_freeze > 0)
+    {
+        screen_info->area_pending = TRUE;
+        return;
+    }
 
+    display_info = screen_info->display_info;
     for (i = 0; i < 4; i++)
     {
+        prev_margins[i] = screen_info->margins[i];
         screen_info->margins[i] = screen_info->gnome_margins[i];
     }
 
     xfwm_get_primary_monitor_geometry (screen_info->gscr, &workarea);
 
-    for (c = screen_info->clients, i = 0; i < screen_info->client_count; c = c->next, i++)
+    /* Only the clients with struts can change the margins */
+    for (list = screen_info->strut_clients; list; list = g_list_next (list))
     {
+        c = (Client *) list->data;
         if (strutsToRectangles (c, &left, &right, &top, &bottom))
         {
             /*
@@ -591,15 +815,15 @@ workspaceUpdateArea (ScreenInfo *screen_info)
         }
     }
 
-    if ((prev_top != screen_info->margins[STRUTS_TOP]) ||
-        (prev_left != screen_info->margins[STRUTS_LEFT]) ||
-        (prev_right != screen_info->margins[STRUTS_RIGHT]) ||
-        (prev_bottom != screen_info->margins[STRUTS_BOTTOM]))
+    if ((prev_margins[STRUTS_TOP] != screen_info->margins[STRUTS_TOP]) ||
+        (prev_margins[STRUTS_LEFT] != screen_info->margins[STRUTS_LEFT]) ||
+        (prev_margins[STRUTS_RIGHT] != screen_info->margins[STRUTS_RIGHT]) ||
+        (prev_margins[STRUTS_BOTTOM] != screen_info->margins[STRUTS_BOTTOM]))
     {
         TRACE ("margins have changed, updating net_workarea");
         setNetWorkarea (display_info, screen_info->xroot, screen_info->workspace_count,
                         screen_info->logical_width, screen_info->logical_height, screen_info->margins);
-        /* Also prevent windows from being off screen, just like when screen is resized */
-        clientScreenResize(screen_info, FALSE);
+        /* Also prevent windows from being off screen, next to the edges that moved */
+        clientWorkareaResize (screen_info, prev_margins);
     }
 }
@@ -54,6 +54,8 @@ void                    workspaceSetNames                       (ScreenInfo *,
 void                    workspaceSetCount                       (ScreenInfo *,
                                                                  guint);
 void                    workspaceUpdateArea                     (ScreenInfo *);
+void                    workspaceFreezeArea                     (ScreenInfo *);
+void                    workspaceThawArea                       (ScreenInfo *);
 
 void                    workspaceInsert                         (ScreenInfo *,
                                                                  guint);
@@ -61,4 +63,11 @@ void                    workspaceInsert                         (ScreenInfo *,
 void                    workspaceDelete                         (ScreenInfo *,
                                                                  guint);
 
+void                    workspaceIndexInit                      (ScreenInfo *);
+void                    workspaceIndexClose                     (ScreenInfo *);
+void                    workspaceIndexUpdate                    (Client *);
+void                    workspaceIndexRemove                    (Client *);
+GList                  *workspaceGetClients                     (ScreenInfo *,
+                                                                 guint);
+
 #endif /* INC_WORKSPACES_H */
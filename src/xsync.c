@@ -25,6 +25,7 @@
 #endif
 
 #include "xsync.h"
+#include "compositor.h"
 
 #ifdef HAVE_XSYNC
 
@@ -43,6 +44,80 @@ addToXSyncValue (XSyncValue *value, gint i)
     XSyncValueAdd (value, *value, add, &overflow);
 }
 
+/* Smoothed round trip and its deviation, with the usual RFC 6298 weights */
+static void
+clientXSyncUpdateRoundTrip (Client *c)
+{
+    gint64 sample;
+    gint64 delta;
+
+    if (c->xsync_request_time == 0)
+    {
+        return;
+    }
+
+    sample = g_get_monotonic_time () - c->xsync_request_time;
+    c->xsync_request_time = 0;
+    if (sample <= 0)
+    {
+        return;
+    }
+
+    if (c->xsync_srtt == 0)
+    {
+        c->xsync_srtt = (guint) sample;
+        c->xsync_rttvar = (guint) sample / 2;
+    }
+    else
+    {
+        delta = ABS ((gint64) c->xsync_srtt - sample);
+        c->xsync_rttvar = (guint) ((3 * (gint64) c->xsync_rttvar + delta) / 4);
+        c->xsync_srtt = (guint) ((7 * (gint64) c->xsync_srtt + sample) / 8);
+    }
+    TRACE ("client \"%s\" (0x%lx) rtt %u usec, srtt %u usec, rttvar %u usec",
+           c->name, c->window, (guint) sample, c->xsync_srtt, c->xsync_rttvar);
+}
+
+/* How long the client may take to answer before XSync is disabled, in ms */
+static guint
+clientXSyncGetTimeout (Client *c)
+{
+    if (c->xsync_srtt == 0)
+    {
+        return CLIENT_XSYNC_TIMEOUT;
+    }
+    return CLAMP (4 * (c->xsync_srtt + 4 * c->xsync_rttvar) / 1000,
+                  CLIENT_XSYNC_TIMEOUT, CLIENT_XSYNC_MAX_TIMEOUT);
+}
+
+/* How long a new size waits for the previous one to be drawn, in ms */
+static guint
+clientXSyncGetInterval (Client *c)
+{
+    if (c->xsync_srtt == 0)
+    {
+        return clientXSyncGetTimeout (c);
+    }
+    return CLAMP ((c->xsync_srtt + 4 * c->xsync_rttvar) / 1000,
+                  CLIENT_XSYNC_MIN_INTERVAL, clientXSyncGetTimeout (c));
+}
+
+static void
+clientXSyncFrameDone (Client *c)
+{
+    ScreenInfo *screen_info;
+    DisplayInfo *display_info;
+
+    if (FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_EXT_COUNTER))
+    {
+        screen_info = c->screen_info;
+        display_info = screen_info->display_info;
+
+        /* Paint what the compositor held back while the frame was drawn */
+        compositorRepairWindow (display_info, c->frame);
+    }
+}
+
 gboolean
 clientCreateXSyncAlarm (Client *c)
 {
@@ -75,6 +150,7 @@ clientCreateXSyncAlarm (Client *c)
     }
 
     c->next_xsync_value = c->xsync_value;
+    c->xsync_sent_value = c->xsync_value;
     if (!FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_EXT_COUNTER) ||
         (XSyncValueLow32(c->next_xsync_value) % 2 == 0))
     {
@@ -188,7 +264,9 @@ clientXSyncTimeout (gpointer data)
     if (c)
     {
         g_warning ("XSync timeout for client \"%s\" (0x%lx)", c->name, c->window);
+        c->xsync_timeout_id = 0;
         clientXSyncClearTimeout (c);
+        clientXSyncFrameDone (c);
 
         /* Disable XSync for this client */
         FLAG_UNSET (c->flags, CLIENT_FLAG_XSYNC_ENABLED);
@@ -205,10 +283,35 @@ clientXSyncResetTimeout (Client * c)
 
     clientXSyncClearTimeout (c);
     c->xsync_timeout_id = g_timeout_add_full (G_PRIORITY_DEFAULT,
-                                              CLIENT_XSYNC_TIMEOUT,
+                                              clientXSyncGetTimeout (c),
                                               clientXSyncTimeout, c, NULL);
 }
 
+gboolean
+clientXSyncReady (Client * c)
+{
+    g_return_val_if_fail (c != NULL, TRUE);
+
+    if (!FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_WAITING))
+    {
+        return TRUE;
+    }
+
+    /* Do not hold a resize for longer than this client usually needs */
+    return (g_get_monotonic_time () - c->xsync_request_time >=
+            (gint64) clientXSyncGetInterval (c) * 1000);
+}
+
+gboolean
+clientXSyncFramePending (Client * c)
+{
+    g_return_val_if_fail (c != NULL, FALSE);
+
+    /* With the extended counter, an odd value means a frame is being drawn */
+    return (FLAG_TEST_ALL (c->flags, CLIENT_FLAG_XSYNC_WAITING | CLIENT_FLAG_XSYNC_EXT_COUNTER) &&
+            (XSyncValueLow32 (c->xsync_value) % 2 == 1));
+}
+
 void
 clientXSyncRequest (Client * c)
 {
@@ -222,7 +325,7 @@ clientXSyncRequest (Client * c)
 
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
-    if (FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_WAITING))
+    if (!clientXSyncReady (c))
     {
         return;
     }
@@ -233,6 +336,7 @@ clientXSyncRequest (Client * c)
     next_value = c->next_xsync_value;
     addToXSyncValue (&next_value, XSYNC_VALUE_INCREMENT);
     c->next_xsync_value = next_value;
+    c->xsync_sent_value = next_value;
 
     xev.type = ClientMessage;
     xev.window = c->window;
@@ -245,8 +349,14 @@ clientXSyncRequest (Client * c)
     xev.data.l[4] = (long) (FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_EXT_COUNTER) ? 1 : 0);
     XSendEvent (display_info->dpy, c->window, FALSE, NoEventMask, (XEvent *) &xev);
 
-    clientXSyncResetTimeout (c);
-    FLAG_SET (c->flags, CLIENT_FLAG_XSYNC_WAITING);
+    /* Pace and time from the newest request, but a late client keeps
+     * the timeout of its oldest unanswered one */
+    c->xsync_request_time = g_get_monotonic_time ();
+    if (!FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_WAITING))
+    {
+        clientXSyncResetTimeout (c);
+        FLAG_SET (c->flags, CLIENT_FLAG_XSYNC_WAITING);
+    }
 }
 
 void
@@ -256,15 +366,35 @@ clientXSyncUpdateValue (Client *c, XSyncValue value)
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
     c->xsync_value = value;
-    if (FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_EXT_COUNTER))
+    if (FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_EXT_COUNTER) &&
+        (XSyncValueLow32(c->xsync_value) % 2 == 0))
     {
-        if (XSyncValueLow32(c->xsync_value) % 2 == 0)
-        {
-            addToXSyncValue (&value, 1);
-        }
+        addToXSyncValue (&value, 1);
+    }
+    /* Several requests may be in flight, never reuse a value already sent */
+    if (XSyncValueGreaterThan (value, c->next_xsync_value))
+    {
+        c->next_xsync_value = value;
+    }
+
+    if (FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_EXT_COUNTER) &&
+        (XSyncValueLow32(c->xsync_value) % 2 == 1))
+    {
+        /* Frame started but not drawn yet, keep waiting for it */
+        return;
+    }
+    /* Older requests answered late, the last one sent is still pending */
+    if (XSyncValueLessThan (c->xsync_value, c->xsync_sent_value))
+    {
+        return;
+    }
+
+    if (FLAG_TEST (c->flags, CLIENT_FLAG_XSYNC_WAITING))
+    {
+        clientXSyncUpdateRoundTrip (c);
+        clientXSyncClearTimeout (c);
+        clientXSyncFrameDone (c);
     }
-    c->next_xsync_value = value;
-    clientXSyncClearTimeout (c);
 }
 
 #endif /* HAVE_XSYNC */
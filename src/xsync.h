@@ -50,6 +50,8 @@ void                     clientDestroyXSyncAlarm                (Client *);
 gboolean                 clientGetXSyncCounter                  (Client *);
 void                     clientXSyncClearTimeout                (Client *);
 void                     clientXSyncRequest                     (Client *);
+gboolean                 clientXSyncReady                       (Client *);
+gboolean                 clientXSyncFramePending                (Client *);
 void                     clientXSyncUpdateValue                 (Client *,
                                                                  XSyncValue);
 